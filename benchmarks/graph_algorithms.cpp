@@ -0,0 +1,234 @@
+/*
+ *    Copyright (C) 2026  Jeremy W. Murphy <jeremy.william.murphy@gmail.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file graph_algorithms.cpp
+ * @brief Google Benchmark suite for the RMQ, LCA and ancestor-existence
+ * preprocessing and query paths.
+ *
+ * Run with --benchmark_format=json for machine-readable output; each
+ * registration repeats five times so median and stddev are reported.
+ * The time_per_element counter is seconds per input element (so it prints
+ * in ns at typical sizes).
+ */
+
+#include <common_ancestor_existence.hpp>
+#include <lowest_common_ancestor.hpp>
+#include <range_minimum_query.hpp>
+#include <reflect.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <boost/graph/adjacency_list.hpp>
+
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    enum tree_shape { path, star, balanced, random_tree };
+
+    boost::adjacency_list<> make_tree(tree_shape shape, std::size_t n)
+    {
+        boost::adjacency_list<> result(n);
+        std::mt19937 engine(n);
+        for (std::size_t v = 1; v < n; v++)
+            switch (shape)
+            {
+                case path: add_edge(v - 1, v, result); break;
+                case star: add_edge(0, v, result); break;
+                case balanced: add_edge((v - 1) / 2, v, result); break;
+                case random_tree:
+                    add_edge(std::uniform_int_distribution<std::size_t>(0, v - 1)(engine), v, result);
+                    break;
+            }
+        return result;
+    }
+
+    // A sparse random DAG with a handful of sources.
+    boost::adjacency_list<boost::vecS, boost::vecS, boost::bidirectionalS>
+    make_dag(std::size_t n)
+    {
+        boost::adjacency_list<boost::vecS, boost::vecS, boost::bidirectionalS> result(n);
+        std::mt19937 engine(n);
+        for (std::size_t v = 8; v < n; v++)
+        {
+            std::uniform_int_distribution<std::size_t> parent(0, v - 1);
+            add_edge(parent(engine), v, result);
+            add_edge(parent(engine), v, result);
+        }
+        return result;
+    }
+
+    std::vector<unsigned> random_values(std::size_t n)
+    {
+        std::vector<unsigned> result(n);
+        std::mt19937 engine(n);
+        std::uniform_int_distribution<unsigned> d;
+        for (unsigned &x : result)
+            x = d(engine);
+        return result;
+    }
+
+    void report_per_element(benchmark::State &state, std::size_t n)
+    {
+        state.SetItemsProcessed(state.iterations() * n);
+        state.counters["time_per_element"] =
+            benchmark::Counter(n, benchmark::Counter::kIsIterationInvariantRate
+                                  | benchmark::Counter::kInvert);
+    }
+}
+
+
+static void BM_RMQ_sparse_table(benchmark::State &state)
+{
+    auto const a = random_values(state.range(0));
+    general::flat_table<std::size_t> table(general::sparse_table_rows(a.size()), a.size());
+    for (auto _ : state)
+    {
+        general::RMQ_sparse_table(a, table);
+        benchmark::DoNotOptimize(table.data());
+    }
+    report_per_element(state, a.size());
+}
+BENCHMARK(BM_RMQ_sparse_table)->RangeMultiplier(16)->Range(1 << 10, 1 << 22)
+                              ->Repetitions(5)->ReportAggregatesOnly()
+                              ->Unit(benchmark::kMicrosecond);
+
+
+static void BM_RMQ(benchmark::State &state)
+{
+    auto const a = random_values(state.range(0));
+    general::flat_table<std::size_t> table(general::sparse_table_rows(a.size()), a.size());
+    general::RMQ_sparse_table(a, table);
+    std::mt19937 engine(a.size());
+    std::uniform_int_distribution<std::size_t> d(0, a.size() - 1);
+    std::vector<std::pair<std::size_t, std::size_t>> queries(1024);
+    for (auto &q : queries)
+    {
+        q = std::make_pair(d(engine), d(engine));
+        if (q.second < q.first)
+            std::swap(q.first, q.second);
+    }
+    std::size_t next = 0;
+    for (auto _ : state)
+    {
+        auto const &q = queries[next++ & 1023];
+        benchmark::DoNotOptimize(general::RMQ(q.first, q.second, a, table));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RMQ)->RangeMultiplier(16)->Range(1 << 10, 1 << 22)
+                 ->Repetitions(5)->ReportAggregatesOnly();
+
+
+static void BM_LCA_preprocess(benchmark::State &state, tree_shape shape)
+{
+    std::size_t const n = state.range(0), m = 2 * n - 1;
+    auto const tree = make_tree(shape, n);
+    std::vector<std::size_t> tour(m), level(m), representative(n);
+    general::flat_table<std::size_t> table(general::sparse_table_rows(m), m);
+    graph_algorithms::LCA_tour_arena<boost::adjacency_list<>> arena;
+    for (auto _ : state)
+    {
+        graph_algorithms::LCA_preprocess(tree, tour.begin(), level,
+                                         representative.begin(), table, arena);
+        benchmark::DoNotOptimize(table.data());
+    }
+    report_per_element(state, n);
+}
+BENCHMARK_CAPTURE(BM_LCA_preprocess, path, path)
+    ->RangeMultiplier(16)->Range(1 << 10, 1 << 18)
+    ->Repetitions(5)->ReportAggregatesOnly()->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_LCA_preprocess, star, star)
+    ->RangeMultiplier(16)->Range(1 << 10, 1 << 18)
+    ->Repetitions(5)->ReportAggregatesOnly()->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_LCA_preprocess, balanced, balanced)
+    ->RangeMultiplier(16)->Range(1 << 10, 1 << 18)
+    ->Repetitions(5)->ReportAggregatesOnly()->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_LCA_preprocess, random, random_tree)
+    ->RangeMultiplier(16)->Range(1 << 10, 1 << 18)
+    ->Repetitions(5)->ReportAggregatesOnly()->Unit(benchmark::kMicrosecond);
+
+
+static void BM_LCA(benchmark::State &state, tree_shape shape)
+{
+    std::size_t const n = state.range(0);
+    auto const tree = make_tree(shape, n);
+    graph_algorithms::lowest_common_ancestor<boost::adjacency_list<>> const lca(tree);
+    std::mt19937 engine(n);
+    std::uniform_int_distribution<std::size_t> d(0, n - 1);
+    std::vector<std::pair<std::size_t, std::size_t>> queries(1024);
+    for (auto &q : queries)
+        q = std::make_pair(d(engine), d(engine));
+    std::size_t next = 0;
+    for (auto _ : state)
+    {
+        auto const &q = queries[next++ & 1023];
+        benchmark::DoNotOptimize(lca(q.first, q.second));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_CAPTURE(BM_LCA, path, path)
+    ->RangeMultiplier(16)->Range(1 << 10, 1 << 18)
+    ->Repetitions(5)->ReportAggregatesOnly();
+BENCHMARK_CAPTURE(BM_LCA, star, star)
+    ->RangeMultiplier(16)->Range(1 << 10, 1 << 18)
+    ->Repetitions(5)->ReportAggregatesOnly();
+BENCHMARK_CAPTURE(BM_LCA, balanced, balanced)
+    ->RangeMultiplier(16)->Range(1 << 10, 1 << 18)
+    ->Repetitions(5)->ReportAggregatesOnly();
+BENCHMARK_CAPTURE(BM_LCA, random, random_tree)
+    ->RangeMultiplier(16)->Range(1 << 10, 1 << 18)
+    ->Repetitions(5)->ReportAggregatesOnly();
+
+
+static void BM_reflect_through_sources(benchmark::State &state)
+{
+    auto const dag = make_dag(state.range(0));
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto g = dag;
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(graph_algorithms::reflect_through_sources(g));
+    }
+    report_per_element(state, num_vertices(dag));
+}
+BENCHMARK(BM_reflect_through_sources)->RangeMultiplier(8)->Range(1 << 10, 1 << 16)
+                                     ->Repetitions(5)->ReportAggregatesOnly()
+                                     ->Unit(benchmark::kMicrosecond);
+
+
+static void BM_create_common_ancestor_existence_tc(benchmark::State &state)
+{
+    auto const dag = make_dag(state.range(0));
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto g = dag;
+        boost::adjacency_list<> F;
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(graph_algorithms::create_common_ancestor_existence_tc(g, F));
+        benchmark::DoNotOptimize(F);
+    }
+    report_per_element(state, num_vertices(dag));
+}
+BENCHMARK(BM_create_common_ancestor_existence_tc)->RangeMultiplier(4)->Range(1 << 6, 1 << 10)
+                                                 ->Repetitions(5)->ReportAggregatesOnly()
+                                                 ->Unit(benchmark::kMillisecond);
@@ -1,6 +1,22 @@
 #include "reflect.hpp"
 
 #include <boost/config.hpp>
+#include <boost/graph/topological_sort.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace graph_algorithms
 {
@@ -20,7 +36,34 @@ namespace graph_algorithms
         boost::transitive_closure(G, tmp);
         auto const E = edges(tmp);
         std::for_each(E.first, E.second, [&](edge_descriptor e){ add_edge(source(e, tmp), target(e, tmp), F); });
-        
+
+        return offset;
+    }
+
+
+    /** @brief Build the closure graph as observed phases.
+     *
+     *  Reports "reflect_through_sources", "transitive_closure" and
+     *  "closure_edges" (items = closure edge count) in order; a
+     *  general::no_instrumentation observer compiles to the overload above.
+     */
+    template <typename Graph, typename MutableGraph, typename Observer>
+    BOOST_DEDUCED_TYPENAME boost::graph_traits<Graph>::vertices_size_type
+    create_common_ancestor_existence_tc(Graph &G, MutableGraph &F, Observer &observer)
+    {
+        typedef BOOST_DEDUCED_TYPENAME boost::graph_traits<Graph>::edge_descriptor edge_descriptor;
+
+        BOOST_DEDUCED_TYPENAME boost::graph_traits<Graph>::vertices_size_type offset = 0;
+        general::instrumented_phase(observer, "reflect_through_sources", num_edges(G), 0, 0,
+                                    [&]{ offset = reflect_through_sources(G); });
+        Graph tmp;
+        general::instrumented_phase(observer, "transitive_closure", num_vertices(G), 0, 0,
+                                    [&]{ boost::transitive_closure(G, tmp); });
+        general::instrumented_phase(observer, "closure_edges", num_edges(tmp), 0, 0, [&]
+        {
+            auto const E = edges(tmp);
+            std::for_each(E.first, E.second, [&](edge_descriptor e){ add_edge(source(e, tmp), target(e, tmp), F); });
+        });
         return offset;
     }
     
@@ -30,4 +73,391 @@ namespace graph_algorithms
     {
         return edge(u + offset, v, F).second;
     }
+
+
+    /** @brief Transitive closure stored as compressed per-vertex reachability rows.
+     *
+     *  An alternative to materializing the closure as graph edges, whose edge
+     *  set explodes on large DAGs.  Rows are computed by unioning successor
+     *  rows in reverse-topological order; each finished row is then kept
+     *  either as packed 64-bit words or, when its set bits form few runs, as
+     *  a sorted interval list, whichever is smaller.
+     *
+     *  Construction partitions the DAG into longest-path levels: vertices on
+     *  one level have no edges between them, so with n_threads > 1 their rows
+     *  are unioned concurrently, with a barrier between levels.
+     *
+     *  Time complexity: O(|V|⋅|E|/w) construction, O(1) or O(lg runs) query.
+     */
+    class ancestor_existence_bitmaps
+    {
+        typedef std::pair<std::uint32_t, std::uint32_t> interval;
+        static_assert(sizeof(interval) == sizeof(std::uint64_t),
+                      "snapshot sections are 64-bit aligned");
+
+        std::size_t n_;
+        std::size_t offset_;
+        std::vector<std::size_t> row_begin_;
+        std::vector<std::size_t> row_end_; // interval rows only
+        std::vector<char> row_packed_;
+        std::vector<std::uint64_t> word_pool_;
+        std::vector<interval> interval_pool_;
+
+        // Below this many vertices a level is not worth a thread.
+        static std::size_t const minimum_grain = 64;
+
+        // Owns a memory-mapped snapshot for instances loaded from disk.
+        struct snapshot_mapping
+        {
+            void *address = MAP_FAILED;
+            std::size_t length = 0;
+            int fd = -1;
+
+            ~snapshot_mapping()
+            {
+                if (address != MAP_FAILED)
+                    munmap(address, length);
+                if (fd != -1)
+                    close(fd);
+            }
+        };
+
+        // "CAEv1".
+        static std::uint64_t const snapshot_magic = 0x4341457631ull;
+
+        std::shared_ptr<snapshot_mapping const> mapping_;
+        std::size_t const *mapped_row_begin_ = nullptr;
+        std::size_t const *mapped_row_end_ = nullptr;
+        char const *mapped_row_packed_ = nullptr;
+        std::uint64_t const *mapped_word_pool_ = nullptr;
+        interval const *mapped_interval_pool_ = nullptr;
+        std::size_t mapped_words_ = 0, mapped_intervals_ = 0;
+
+        std::size_t const *row_begin_data() const
+        { return mapping_ ? mapped_row_begin_ : row_begin_.data(); }
+
+        std::size_t const *row_end_data() const
+        { return mapping_ ? mapped_row_end_ : row_end_.data(); }
+
+        char const *row_packed_data() const
+        { return mapping_ ? mapped_row_packed_ : row_packed_.data(); }
+
+        std::uint64_t const *word_pool_data() const
+        { return mapping_ ? mapped_word_pool_ : word_pool_.data(); }
+
+        interval const *interval_pool_data() const
+        { return mapping_ ? mapped_interval_pool_ : interval_pool_.data(); }
+
+        // Only the named factory builds an instance in stages.
+        ancestor_existence_bitmaps() = default;
+
+    public:
+        /** @brief Build the closure rows of G reflected through its sources.
+         *
+         *  Note: G is modified, as by create_common_ancestor_existence_tc.
+         */
+        template <typename Graph>
+        explicit ancestor_existence_bitmaps(Graph &G, unsigned n_threads = 1)
+        {
+            offset_ = reflect_through_sources(G);
+            build(G, n_threads);
+        }
+
+        /** @brief Build the closure rows over an already reflected graph.
+         *
+         *  For the CSR fast path of reflect_through_sources, whose result is
+         *  immutable and therefore cannot be reflected in place.  A named
+         *  factory rather than a constructor: a (graph, offset) constructor
+         *  is ambiguous with the (graph, n_threads) one above for non-const
+         *  arguments.
+         */
+        template <typename Graph>
+        static ancestor_existence_bitmaps
+        from_reflected(Graph const &F, std::size_t offset, unsigned n_threads = 1)
+        {
+            ancestor_existence_bitmaps result;
+            result.offset_ = offset;
+            result.build(F, n_threads);
+            return result;
+        }
+
+        /** @brief Serve queries directly out of a snapshot written by save().
+         *
+         *  The file is memory-mapped read-only and the rows are used in
+         *  place, paged in lazily on first query, so cold start is the cost
+         *  of an mmap rather than of recomputing the transitive closure.
+         *  The mapping is shared by copies.
+         */
+        explicit ancestor_existence_bitmaps(std::string const &path)
+        {
+            auto const mapping = std::make_shared<snapshot_mapping>();
+            mapping->fd = open(path.c_str(), O_RDONLY);
+            if (mapping->fd == -1)
+                throw std::runtime_error("ancestor_existence_bitmaps: cannot open " + path);
+            struct stat status;
+            if (fstat(mapping->fd, &status) == -1)
+                throw std::runtime_error("ancestor_existence_bitmaps: cannot stat " + path);
+            mapping->length = status.st_size;
+            mapping->address = mmap(nullptr, mapping->length, PROT_READ, MAP_SHARED,
+                                    mapping->fd, 0);
+            if (mapping->address == MAP_FAILED)
+                throw std::runtime_error("ancestor_existence_bitmaps: cannot map " + path);
+
+            std::uint64_t const *words = static_cast<std::uint64_t const *>(mapping->address);
+            if (mapping->length < 5 * sizeof(std::uint64_t) || words[0] != snapshot_magic)
+                throw std::runtime_error("ancestor_existence_bitmaps: not a snapshot: " + path);
+            n_ = words[1];
+            offset_ = words[2];
+            mapped_words_ = words[3];
+            mapped_intervals_ = words[4];
+            std::size_t const packed_words = (n_ + 7) / 8;
+            if (mapping->length != (5 + 2 * n_ + packed_words + mapped_words_
+                                    + mapped_intervals_) * sizeof(std::uint64_t))
+                throw std::runtime_error("ancestor_existence_bitmaps: truncated snapshot: " + path);
+
+            mapped_row_begin_ = reinterpret_cast<std::size_t const *>(words + 5);
+            mapped_row_end_ = mapped_row_begin_ + n_;
+            mapped_row_packed_ = reinterpret_cast<char const *>(words + 5 + 2 * n_);
+            mapped_word_pool_ = words + 5 + 2 * n_ + packed_words;
+            mapped_interval_pool_ = reinterpret_cast<interval const *>(
+                mapped_word_pool_ + mapped_words_);
+            mapping_ = mapping;
+        }
+
+        /** @brief Write a binary snapshot of the closure rows.
+         *
+         *  All sections are 64-bit aligned so the mmap constructor can use
+         *  them in place.
+         */
+        void save(std::string const &path) const
+        {
+            std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+            if (!out)
+                throw std::runtime_error("ancestor_existence_bitmaps: cannot write " + path);
+            auto const put = [&out](void const *data, std::size_t bytes)
+            {
+                out.write(static_cast<char const *>(data), bytes);
+            };
+            std::size_t const words = mapping_ ? mapped_words_ : word_pool_.size();
+            std::size_t const intervals = mapping_ ? mapped_intervals_ : interval_pool_.size();
+            std::uint64_t const header[5] = {snapshot_magic, n_, offset_, words, intervals};
+            put(header, sizeof(header));
+            put(row_begin_data(), n_ * sizeof(std::size_t));
+            put(row_end_data(), n_ * sizeof(std::size_t));
+            std::vector<char> packed(row_packed_data(), row_packed_data() + n_);
+            packed.resize(8 * ((n_ + 7) / 8), 0);
+            put(packed.data(), packed.size());
+            put(word_pool_data(), words * sizeof(std::uint64_t));
+            put(interval_pool_data(), intervals * sizeof(interval));
+            if (!out)
+                throw std::runtime_error("ancestor_existence_bitmaps: cannot write " + path);
+        }
+
+    private:
+        template <typename Graph>
+        void build(Graph const &G, unsigned n_threads)
+        {
+            typedef BOOST_DEDUCED_TYPENAME boost::graph_traits<Graph>::vertex_descriptor vertex_descriptor;
+
+            n_ = num_vertices(G);
+            std::size_t const words = (n_ + 63) / 64;
+
+            // BGL emits reverse topological order, so successors come first.
+            std::vector<vertex_descriptor> order;
+            order.reserve(n_);
+            boost::topological_sort(G, std::back_inserter(order));
+
+            std::vector<std::vector<std::uint64_t>> row(n_);
+            auto const build_row = [&](vertex_descriptor v)
+            {
+                row[v].assign(words, 0);
+                auto const E_v = out_edges(v, G);
+                std::for_each(E_v.first, E_v.second, [&](decltype(*E_v.first) e)
+                {
+                    vertex_descriptor const w = target(e, G);
+                    for (std::size_t k = 0; k != words; k++)
+                        row[v][k] |= row[w][k];
+                    row[v][w / 64] |= std::uint64_t(1) << (w % 64);
+                });
+            };
+
+            // Longest-path level of each vertex, counted up from the sinks.
+            std::vector<std::size_t> level(n_, 0);
+            std::size_t n_levels = n_ == 0 ? 0 : 1;
+            for (vertex_descriptor const v : order)
+            {
+                auto const E_v = out_edges(v, G);
+                std::for_each(E_v.first, E_v.second, [&](decltype(*E_v.first) e)
+                {
+                    level[v] = std::max(level[v], level[target(e, G)] + 1);
+                });
+                n_levels = std::max(n_levels, level[v] + 1);
+            }
+            std::vector<std::vector<vertex_descriptor>> bucket(n_levels);
+            for (vertex_descriptor const v : order)
+                bucket[level[v]].push_back(v);
+
+            for (std::vector<vertex_descriptor> const &peers : bucket)
+                if (n_threads < 2 || peers.size() < 2 * minimum_grain)
+                    std::for_each(peers.begin(), peers.end(), build_row);
+                else
+                {
+                    std::size_t const grain = (peers.size() + n_threads - 1) / n_threads;
+                    std::vector<std::thread> workers;
+                    for (std::size_t lo = 0; lo < peers.size(); lo += grain)
+                    {
+                        std::size_t const hi = std::min(lo + grain, peers.size());
+                        workers.emplace_back([&, lo, hi]()
+                        {
+                            std::for_each(peers.begin() + lo, peers.begin() + hi, build_row);
+                        });
+                    }
+                    // Joining is the barrier: the next level reads these rows.
+                    for (std::thread &worker : workers)
+                        worker.join();
+                }
+
+            row_begin_.resize(n_);
+            row_end_.resize(n_);
+            row_packed_.resize(n_);
+            for (std::size_t v = 0; v != n_; v++)
+            {
+                std::vector<interval> runs;
+                for (std::size_t b = 0; b != n_; b++)
+                    if (row[v][b / 64] >> (b % 64) & 1)
+                    {
+                        if (runs.empty() || runs.back().second + 1 != b)
+                            runs.push_back(interval(b, b));
+                        else
+                            runs.back().second = b;
+                    }
+                if (runs.size() < words)
+                {
+                    row_packed_[v] = false;
+                    row_begin_[v] = interval_pool_.size();
+                    interval_pool_.insert(interval_pool_.end(), runs.begin(), runs.end());
+                    row_end_[v] = interval_pool_.size();
+                }
+                else
+                {
+                    row_packed_[v] = true;
+                    row_begin_[v] = word_pool_.size();
+                    word_pool_.insert(word_pool_.end(), row[v].begin(), row[v].end());
+                }
+                row[v].clear();
+                row[v].shrink_to_fit();
+            }
+        }
+
+    public:
+        /// Can v be reached from x?
+        bool reachable(std::size_t x, std::size_t v) const
+        {
+            if (row_packed_data()[x])
+                return word_pool_data()[row_begin_data()[x] + v / 64] >> (v % 64) & 1;
+            interval const *const first = interval_pool_data() + row_begin_data()[x],
+                           *const last = interval_pool_data() + row_end_data()[x];
+            auto const it = std::upper_bound(first, last, interval(v, ~std::uint32_t(0)));
+            return it != first && v <= (it - 1)->second;
+        }
+
+        /// Do u and v have a common ancestor?
+        template <typename Vertex>
+        bool operator()(Vertex u, Vertex v) const
+        {
+            return reachable(u + offset_, v);
+        }
+
+        /** @brief Answer one u against many candidates with one row fetch.
+         *
+         *  Writes one bool per candidate to out, in candidate order.  The
+         *  row of u + offset is resolved once: a packed row is then a word
+         *  test per candidate, and an interval row is walked with a cursor
+         *  that only restarts (by binary search) when the candidates go
+         *  backwards — sorted candidates traverse the intervals once.
+         *
+         *  Time complexity: O(k) packed, O(k + runs) sorted intervals.
+         */
+        template <typename Vertex, typename InputIterator, typename OutputIterator>
+        OutputIterator common_ancestors_exist(Vertex u, InputIterator v_first,
+                                              InputIterator v_last, OutputIterator out) const
+        {
+            std::size_t const x = u + offset_;
+            if (row_packed_data()[x])
+            {
+                std::uint64_t const *const row = word_pool_data() + row_begin_data()[x];
+                for (; v_first != v_last; ++v_first)
+                    *out++ = row[*v_first / 64] >> (*v_first % 64) & 1;
+                return out;
+            }
+            interval const *const first = interval_pool_data() + row_begin_data()[x],
+                           *const last = interval_pool_data() + row_end_data()[x];
+            interval const *cursor = first;
+            std::size_t previous = 0;
+            for (; v_first != v_last; ++v_first)
+            {
+                std::size_t const v = *v_first;
+                if (v < previous)
+                    cursor = std::upper_bound(first, last, interval(v, ~std::uint32_t(0)));
+                else
+                    while (cursor != last && cursor->first <= v)
+                        ++cursor;
+                previous = v;
+                *out++ = cursor != first && v <= (cursor - 1)->second;
+            }
+            return out;
+        }
+
+        std::size_t offset() const { return offset_; }
+    };
+
+
+    template <typename Vertex>
+    bool does_common_ancestor_exist(Vertex u, Vertex v, ancestor_existence_bitmaps const &index)
+    {
+        return index(u, v);
+    }
+
+
+    /** @brief Answer one u against many candidates with one row scan of F.
+     *
+     *  The bulk form of does_common_ancestor_exist(u, v, F, offset): the
+     *  adjacency row of u + offset is fetched once and every out-neighbour
+     *  is tested word-at-a-time against a bitmap of the candidates, turning
+     *  one edge() lookup per candidate into a single scan of the row.
+     *  Candidates must be multipass; results are written in candidate order.
+     *
+     *  Time complexity: O(k + out-degree(u + offset) + |V|/w)
+     */
+    template <typename Vertex, typename InputIterator, typename Graph, typename N,
+              typename OutputIterator>
+    OutputIterator common_ancestors_exist(Vertex u, InputIterator v_first, InputIterator v_last,
+                                          Graph const &F, N offset, OutputIterator out)
+    {
+        std::size_t const words = (num_vertices(F) + 63) / 64;
+        std::vector<std::uint64_t> candidate(words, 0), hit(words, 0);
+        std::for_each(v_first, v_last, [&](Vertex v)
+        {
+            candidate[v / 64] |= std::uint64_t(1) << (v % 64);
+        });
+        auto const E_u = out_edges(u + offset, F);
+        std::for_each(E_u.first, E_u.second, [&](decltype(*E_u.first) e)
+        {
+            auto const w = target(e, F);
+            hit[w / 64] |= candidate[w / 64] & (std::uint64_t(1) << (w % 64));
+        });
+        for (; v_first != v_last; ++v_first)
+            *out++ = hit[*v_first / 64] >> (*v_first % 64) & 1;
+        return out;
+    }
+
+
+    /// Bulk existence queries against the compressed closure rows.
+    template <typename Vertex, typename InputIterator, typename OutputIterator>
+    OutputIterator common_ancestors_exist(Vertex u, InputIterator v_first, InputIterator v_last,
+                                          ancestor_existence_bitmaps const &index,
+                                          OutputIterator out)
+    {
+        return index.common_ancestors_exist(u, v_first, v_last, out);
+    }
 }
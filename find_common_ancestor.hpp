@@ -26,9 +26,12 @@
 #include "visitors.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <vector>
 #include <iterator>
 #include <functional>
+#include <thread>
+#include <type_traits>
 #include <unordered_map>
 
 #include <boost/concept/assert.hpp>
@@ -46,7 +49,7 @@
 namespace graph_algorithms
 {
     /**
-     *  @brief Finds the first vertex that has a common ancestor 
+     *  @brief Finds the first vertex that has a common ancestor
      *  @ingroup non_mutating_algorithms
      *  @param  H           Directed acyclic graph (typically the reverse of another graph).
      *  @param  first       Beginning of vertices to search.
@@ -55,7 +58,12 @@ namespace graph_algorithms
      *  @param  searched    Which vertices have been searched for a common ancestor.
      *  @param  q           Additional (?) vertices to search.
      *  @param  predecessor Vertex predecessors seen during search.
-     * 
+     *
+     *  The breadth-first visit is an explicit loop rather than a
+     *  boost::breadth_first_visit with a throwing visitor: a hit is the
+     *  common case, so early exit must be a normal return, not an unwound
+     *  found_something exception.  Colour, queue and predecessor state are
+     *  left exactly as the visitor-based version left them.
      */
     template <typename IncidenceGraph, typename VertexInputIterator, typename VertexColourPropMap, typename VertexQueue, typename VertexVertexMap>
     std::pair<VertexInputIterator, typename boost::graph_traits<IncidenceGraph>::vertex_descriptor>
@@ -63,52 +71,75 @@ namespace graph_algorithms
     {
         using namespace boost;
         using namespace std::placeholders;
-        
+
         typedef BOOST_DEDUCED_TYPENAME graph_traits<IncidenceGraph>::vertex_descriptor vertex_descriptor;
 
         BOOST_CONCEPT_ASSERT((IncidenceGraphConcept<IncidenceGraph>));
         BOOST_CONCEPT_ASSERT((InputIterator<VertexInputIterator>));
-        
-        // TODO: Make a decision about how best to do this.
+
         typedef std::equal_to<default_color_type> EqualColour;
-        auto const stop_if_black_vertex = make_stop_on_vertex(std::bind(prop_relation_wrapper<vertex_descriptor, IncidenceGraph, VertexColourPropMap, default_color_type, EqualColour>, _1, _2, ancestors, black_color, EqualColour()), on_discover_vertex());
-        // auto const stop_if_black_vertex = make_stop_on_discover_vertex_if([&](vertex_descriptor v, ReversedGraph const &){ return get(target, v) == black_color; });
-        auto const foo = make_bfs_visitor(std::make_pair(stop_if_black_vertex, record_predecessors(make_assoc_property_map(predecessor), boost::on_tree_edge())));
-        
-        vertex_descriptor v;
-        try
+        auto const is_target = std::bind(prop_relation_wrapper<vertex_descriptor, IncidenceGraph, VertexColourPropMap, default_color_type, EqualColour>, _1, H, ancestors, black_color, EqualColour());
+
+        for (; first != last; ++first)
         {
-            for (; first != last; ++first)
+            vertex_descriptor const v = *first;
+            // BGL does not check source vertex colour, so we do.
+            if (get(searched, v) == black_color)
+                continue;
+            predecessor.clear();
+
+            bool hit = is_target(v);
+            vertex_descriptor found = v;
+            if (!hit)
             {
-                v = *first;
-                // BGL does not check source vertex colour, so we do.
-                if (get(searched, v) != black_color)
+                put(searched, v, gray_color);
+                // Clear q? Or is there a use to allowing preloaded values?
+                q.push(v);
+                while (!q.empty() && !hit)
                 {
-                    predecessor.clear();
-                    // Clear q? Or is there a use to allowing preloaded values?
-                    breadth_first_visit(H, v, q, foo, searched);
+                    vertex_descriptor const u = q.top();
+                    q.pop();
+                    auto const E_u = out_edges(u, H);
+                    for (auto e = E_u.first; e != E_u.second; ++e)
+                    {
+                        vertex_descriptor const w = target(*e, H);
+                        if (get(searched, w) != white_color)
+                            continue;
+                        predecessor[w] = u;
+                        if (is_target(w))
+                        {
+                            hit = true;
+                            found = w;
+                            break;
+                        }
+                        put(searched, w, gray_color);
+                        q.push(w);
+                    }
+                    if (!hit)
+                        put(searched, u, black_color);
                 }
             }
-        }
-        catch (found_something<vertex_descriptor> const &e)
-        {
-            // Mark all predecessors in search space back to white.
-            typedef BOOST_DEDUCED_TYPENAME VertexVertexMap::value_type value_type;
-            std::for_each(std::begin(predecessor), std::end(predecessor), [&](value_type const &x)
-            {
-                put(searched, x.first, white_color);
-            });
-            put(searched, v, white_color);
 
-            // Mark the path from the source vertex to the target black, 
-            // thereby increasing the size of the target.
-            for (auto u = e.thing; u != v; )
+            if (hit)
             {
-                u = predecessor[u];
-                put(ancestors, u, black_color);
+                // Mark all predecessors in search space back to white.
+                typedef BOOST_DEDUCED_TYPENAME VertexVertexMap::value_type value_type;
+                std::for_each(std::begin(predecessor), std::end(predecessor), [&](value_type const &x)
+                {
+                    put(searched, x.first, white_color);
+                });
+                put(searched, v, white_color);
+
+                // Mark the path from the source vertex to the target black,
+                // thereby increasing the size of the target.
+                for (auto u = found; u != v; )
+                {
+                    u = predecessor[u];
+                    put(ancestors, u, black_color);
+                }
+
+                return std::make_pair(first, found);
             }
-            
-            return std::make_pair(first, e.thing);
         }
         return std::make_pair(last, 0);
     }
@@ -147,9 +178,126 @@ namespace graph_algorithms
         
         auto const H = make_reverse_graph(G);
         breadth_first_visit(H, u, q, default_bfs_visitor(), ancestors);
-        
+
         return find_common_ancestor_impl(H, first, last, ancestors, searched, q, predecessor);
     }
+
+
+    /** @brief Colour map over contiguous storage that records which vertices
+     *  were painted, so restoring all-white between queries costs only the
+     *  painted set rather than O(|V|).
+     */
+    template <typename Vertex>
+    struct recording_colour_map
+    {
+        typedef Vertex key_type;
+        typedef boost::default_color_type value_type;
+        typedef boost::default_color_type reference;
+        typedef boost::read_write_property_map_tag category;
+
+        std::vector<boost::default_color_type> *colour;
+        std::vector<Vertex> *painted;
+
+        void reset() const
+        {
+            for (Vertex const v : *painted)
+                (*colour)[v] = boost::white_color;
+            painted->clear();
+        }
+    };
+
+    template <typename Vertex>
+    boost::default_color_type get(recording_colour_map<Vertex> const &m, Vertex v)
+    {
+        return (*m.colour)[v];
+    }
+
+    template <typename Vertex>
+    void put(recording_colour_map<Vertex> const &m, Vertex v, boost::default_color_type c)
+    {
+        if ((*m.colour)[v] == boost::white_color && c != boost::white_color)
+            m.painted->push_back(v);
+        (*m.colour)[v] = c;
+    }
+
+
+    /**
+     *  @brief Answer a find_common_ancestor query for many source vertices.
+     *  @ingroup non_mutating_algorithms
+     *  @param  G         Directed acyclic graph; integral contiguous vertex
+     *                    descriptors.
+     *  @param  sources_first, sources_last  Source vertices, one query each.
+     *  @param  first, last  Vertices to search, shared by every query.
+     *  @param  result    One (iterator, ancestor) pair per source, in order.
+     *  @param  n_threads Number of worker threads.
+     *
+     *  One reversed-graph view and one set of colour/queue/predecessor
+     *  structures per worker are shared across all of that worker's
+     *  queries, with only the painted vertices restored in between, so the
+     *  per-query O(|V|) property-map initialization of the single-shot
+     *  function is amortized away.  Workers claim queries from a shared
+     *  cursor, so skewed query costs balance dynamically.
+     */
+    template <typename VertexListGraph, typename SourceIterator,
+              typename VertexInputIterator, typename OutputIterator>
+    OutputIterator
+    find_common_ancestor_batch(VertexListGraph const &G,
+                               SourceIterator sources_first, SourceIterator sources_last,
+                               VertexInputIterator first, VertexInputIterator last,
+                               OutputIterator result, unsigned n_threads = 1)
+    {
+        using namespace boost;
+
+        typedef BOOST_DEDUCED_TYPENAME graph_traits<VertexListGraph>::vertex_descriptor vertex_descriptor;
+
+        BOOST_CONCEPT_ASSERT((VertexListGraphConcept<VertexListGraph>));
+        static_assert(std::is_integral<vertex_descriptor>::value,
+                      "find_common_ancestor_batch requires integral contiguous vertex descriptors");
+
+        auto const H = make_reverse_graph(G);
+        std::vector<vertex_descriptor> const sources(sources_first, sources_last);
+        std::vector<std::pair<VertexInputIterator, vertex_descriptor>> answer(sources.size());
+        std::atomic<std::size_t> cursor(0);
+
+        auto const worker = [&]
+        {
+            std::vector<default_color_type> ancestor_colour(num_vertices(G), white_color),
+                                            searched_colour(num_vertices(G), white_color);
+            std::vector<vertex_descriptor> ancestor_painted, searched_painted;
+            recording_colour_map<vertex_descriptor> const
+                ancestors{&ancestor_colour, &ancestor_painted},
+                searched{&searched_colour, &searched_painted};
+            queue<vertex_descriptor> q;
+            std::unordered_map<vertex_descriptor, vertex_descriptor> predecessor;
+
+            for (std::size_t next; (next = cursor.fetch_add(1)) < sources.size(); )
+            {
+                breadth_first_visit(H, sources[next], q, default_bfs_visitor(), ancestors);
+                answer[next] = find_common_ancestor_impl(H, first, last, ancestors,
+                                                         searched, q, predecessor);
+                // A hit returns with vertices still enqueued; drain them so
+                // they cannot seed the next query's visit.
+                while (!q.empty())
+                    q.pop();
+                ancestors.reset();
+                searched.reset();
+                predecessor.clear();
+            }
+        };
+
+        if (n_threads < 2 || sources.size() < 2)
+            worker();
+        else
+        {
+            std::vector<std::thread> pool;
+            pool.reserve(n_threads);
+            for (unsigned t = 0; t != n_threads; t++)
+                pool.emplace_back(worker);
+            for (std::thread &w : pool)
+                w.join();
+        }
+        return std::copy(answer.begin(), answer.end(), result);
+    }
 }
 
 #endif
@@ -0,0 +1,94 @@
+/*
+    Copyright (C) 2014  Jeremy W. Murphy <jeremy.william.murphy@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file flat_table.hpp
+ * @brief Minimal contiguous 2-d table.
+ */
+
+#ifndef FLAT_TABLE_HPP
+#define FLAT_TABLE_HPP
+
+#include <boost/assert.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace general
+{
+    /**
+     * @brief A 2-d table in one contiguous allocation with a row stride.
+     *
+     * Purpose-built for the RMQ Sparse Table hot path: indexing a row yields
+     * a raw pointer, so a query is plain pointer arithmetic with no view or
+     * index-generation machinery between the caller and the data.
+     */
+    template <typename T>
+    class flat_table
+    {
+    public:
+        typedef T value_type;
+        typedef std::size_t size_type;
+
+        flat_table() : stride_(0) {}
+
+        flat_table(size_type rows, size_type columns)
+            : data_(rows * columns), stride_(columns) {}
+
+        void resize(size_type rows, size_type columns)
+        {
+            data_.resize(rows * columns);
+            stride_ = columns;
+        }
+
+        T *operator[](size_type row)
+        {
+            BOOST_ASSERT(row * stride_ < data_.size() || data_.empty());
+            return data_.data() + row * stride_;
+        }
+
+        T const *operator[](size_type row) const
+        {
+            BOOST_ASSERT(row * stride_ < data_.size() || data_.empty());
+            return data_.data() + row * stride_;
+        }
+
+        size_type rows() const { return stride_ == 0 ? 0 : data_.size() / stride_; }
+        size_type columns() const { return stride_; }
+        bool empty() const { return data_.empty(); }
+
+        T *data() { return data_.data(); }
+        T const *data() const { return data_.data(); }
+        size_type size() const { return data_.size(); }
+
+        friend bool operator==(flat_table const &x, flat_table const &y)
+        {
+            return x.stride_ == y.stride_ && x.data_ == y.data_;
+        }
+
+        friend bool operator!=(flat_table const &x, flat_table const &y)
+        {
+            return !(x == y);
+        }
+
+    private:
+        std::vector<T> data_;
+        size_type stride_;
+    };
+}
+
+#endif
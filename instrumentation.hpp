@@ -0,0 +1,96 @@
+/*
+    Copyright (C) 2014  Jeremy W. Murphy <jeremy.william.murphy@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file instrumentation.hpp
+ * @brief Per-phase observation of the preprocessing pipelines.
+ */
+
+#ifndef INSTRUMENTATION_HPP
+#define INSTRUMENTATION_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+#include <sys/resource.h>
+
+namespace general
+{
+    /** @brief One observed preprocessing phase.
+     *
+     *  rows and columns are zero for phases that do not produce a table;
+     *  peak_rss_kb is the process high-water mark as of the end of the
+     *  phase, straight from getrusage.
+     */
+    struct phase_report
+    {
+        char const *phase;
+        double seconds;
+        std::size_t items;
+        std::size_t rows, columns;
+        std::size_t peak_rss_kb;
+    };
+
+
+    /** @brief The default observer: a compile-time no-op.
+     *
+     *  enabled is examined in if constexpr, so an instrumented pipeline
+     *  passed this observer contains no clocks, no getrusage calls and no
+     *  reports — the phases run exactly as the uninstrumented overloads.
+     */
+    struct no_instrumentation
+    {
+        static bool const enabled = false;
+
+        void operator()(phase_report const &) const {}
+    };
+
+
+    /// Collects reports in phase order, e.g. to feed a metrics exporter.
+    struct collecting_instrumentation
+    {
+        static bool const enabled = true;
+
+        std::vector<phase_report> reports;
+
+        void operator()(phase_report const &report) { reports.push_back(report); }
+    };
+
+
+    /// Run body as one observed phase; zero overhead when Observer is disabled.
+    template <typename Observer, typename Body>
+    void instrumented_phase(Observer &observer, char const *phase, std::size_t items,
+                            std::size_t rows, std::size_t columns, Body const &body)
+    {
+        if constexpr (Observer::enabled)
+        {
+            auto const start = std::chrono::steady_clock::now();
+            body();
+            std::chrono::duration<double> const elapsed =
+                std::chrono::steady_clock::now() - start;
+            rusage usage = {};
+            getrusage(RUSAGE_SELF, &usage);
+            observer(phase_report{phase, elapsed.count(), items, rows, columns,
+                                  static_cast<std::size_t>(usage.ru_maxrss)});
+        }
+        else
+            body();
+    }
+}
+
+#endif
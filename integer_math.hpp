@@ -38,17 +38,48 @@ namespace general
     }
     
     
+    namespace detail
+    {
+        // log2 of 1..255 for the byte-at-a-time lower_log2 fallback.
+        struct log2_table
+        {
+            char entry[256];
+
+            log2_table()
+            {
+                entry[0] = entry[1] = 0;
+                for (int i = 2; i != 256; i++)
+                    entry[i] = char(entry[i / 2] + 1);
+            }
+        };
+    }
+
+
+    /** Position of the highest set bit.
+     *
+     *  This is the innermost operation of every RMQ (and hence LCA) query,
+     *  so it must not be a data-dependent shift loop: use the hardware
+     *  count-leading-zeros where the compiler provides it, and a small
+     *  lookup table taken a byte at a time otherwise.
+     */
     template <typename N>
     inline
     char lower_log2(N n)
     {
         BOOST_ASSERT(n > 0);
+#if defined(__GNUC__) || defined(__clang__)
+        return char(63 - __builtin_clzll(static_cast<unsigned long long>(n)));
+#else
+        static detail::log2_table const table;
+        unsigned long long x = n;
         char result = 0;
-        
-        while (n >>= 1u)
-            result++;
-        
-        return result;
+        while (x >= 256u)
+        {
+            x >>= 8u;
+            result += 8;
+        }
+        return char(result + table.entry[x]);
+#endif
     }
     
     
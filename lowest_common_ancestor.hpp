@@ -44,8 +44,27 @@
 #include <boost/range/adaptor/indexed.hpp>
 
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 namespace graph_algorithms
 {
     /**
@@ -93,6 +112,188 @@ namespace graph_algorithms
     }
 
 
+    /** @brief Preprocess with one fused traversal instead of two.
+     *  @param Euler_tour_index Preallocated sequence of length 2n - 1.
+     *  @param Euler_tour_level Presized container of length 2n - 1.
+     *  @param representative Preallocated sequence of length n.
+     *  @param sparse_table Sparse table of the levels.
+     *
+     *  The euler_tour visitor writes tour, levels and representatives by
+     *  index in a single DFS, halving traversal and cache traffic relative
+     *  to the eulerian_path + vertex_depth pair above.
+     *
+     *  Time complexity: Θ(n lg n), with one Θ(n) traversal.
+     */
+    template <typename Graph, typename VertexIterator, typename IntegerContainer,
+              typename IndexIterator, typename IndexMultiArray>
+    // requires: Directed(Graph)
+    void LCA_preprocess(Graph const &data, VertexIterator Euler_tour_index,
+                        IntegerContainer &Euler_tour_level, IndexIterator representative,
+                        IndexMultiArray &sparse_table)
+    {
+        using namespace boost;
+        using namespace general;
+
+        typedef typename graph_traits<Graph>::vertex_descriptor vertex_descriptor;
+
+        BOOST_CONCEPT_ASSERT((VertexListGraphConcept<Graph>));
+        BOOST_CONCEPT_ASSERT((RandomAccessContainer<IntegerContainer>));
+
+        // requires: data is a tree
+        BOOST_ASSERT(num_vertices(data) == 0
+                     || Euler_tour_level.size() == 2 * num_vertices(data) - 1);
+
+        depth_first_search(data, visitor(make_euler_tour<vertex_descriptor>(
+            Euler_tour_index, boost::begin(Euler_tour_level), representative))); // Θ(n)
+        RMQ_sparse_table(Euler_tour_level, sparse_table); // Θ(n lg n)
+    }
+
+
+    /** @brief Reusable workspace for the iterative Euler-tour driver.
+     *
+     *  Holds the explicit DFS stack and the visited bitmap so that repeated
+     *  preprocessing runs reuse one allocation; the stack grows to the tree
+     *  height rather than consuming call-stack frames.
+     */
+    template <typename Graph>
+    struct LCA_tour_arena
+    {
+        struct frame
+        {
+            typename boost::graph_traits<Graph>::vertex_descriptor vertex;
+            typename boost::graph_traits<Graph>::out_edge_iterator current, end;
+        };
+
+        std::vector<frame> frames;
+        std::vector<std::uint64_t> visited;
+    };
+
+
+    /** @brief Emit the Euler tour iteratively, without the BGL DFS machinery.
+     *
+     *  A specialized driver for trees with integral contiguous vertex
+     *  descriptors (e.g. adjacency_list with vecS): the recursion is an
+     *  explicit stack in the arena and the colour map is a contiguous
+     *  bitmap, so trees millions of vertices deep neither overflow the call
+     *  stack nor pay per-vertex property-map and visitor dispatch costs.
+     *  Output matches the euler_tour visitor exactly.
+     *
+     *  If progress is given, the number of tour positions written is
+     *  published there with release ordering after every emission, so a
+     *  concurrent consumer may read any published prefix of the output.
+     *
+     *  Time complexity: Θ(n)
+     */
+    template <typename Graph, typename VertexIterator, typename LevelIterator,
+              typename IndexIterator>
+    void LCA_tour_iterative(Graph const &data, VertexIterator Euler_tour_index,
+                            LevelIterator Euler_tour_level, IndexIterator representative,
+                            LCA_tour_arena<Graph> &arena,
+                            std::atomic<std::size_t> *progress = nullptr)
+    {
+        typedef typename boost::graph_traits<Graph>::vertex_descriptor vertex_descriptor;
+
+        static_assert(std::is_integral<vertex_descriptor>::value,
+                      "LCA_tour_iterative requires integral contiguous vertex descriptors");
+
+        std::size_t const n = num_vertices(data);
+        arena.frames.clear();
+        arena.visited.assign((n + 63) / 64, 0);
+        auto const visited = [&arena](vertex_descriptor v)
+        { return (arena.visited[v / 64] >> (v % 64) & 1) != 0; };
+        auto const mark = [&arena](vertex_descriptor v)
+        { arena.visited[v / 64] |= std::uint64_t(1) << (v % 64); };
+
+        std::size_t position = 0;
+        auto const emit = [&](vertex_descriptor v, std::size_t depth)
+        {
+            Euler_tour_index[position] = v;
+            Euler_tour_level[position] = depth;
+            representative[v] = position++;
+            if (progress)
+                progress->store(position, std::memory_order_release);
+        };
+
+        for (std::size_t u = 0; u != n; u++)
+        {
+            if (visited(u))
+                continue;
+            mark(u);
+            emit(u, 0);
+            auto const E_u = out_edges(u, data);
+            arena.frames.push_back({u, E_u.first, E_u.second});
+            while (!arena.frames.empty())
+            {
+                auto &active = arena.frames.back();
+                if (active.current != active.end)
+                {
+                    vertex_descriptor const w = target(*active.current++, data);
+                    if (visited(w))
+                        continue;
+                    mark(w);
+                    emit(w, arena.frames.size());
+                    auto const E_w = out_edges(w, data);
+                    arena.frames.push_back({w, E_w.first, E_w.second});
+                }
+                else
+                {
+                    arena.frames.pop_back();
+                    if (!arena.frames.empty())
+                        emit(arena.frames.back().vertex, arena.frames.size() - 1);
+                }
+            }
+        }
+    }
+
+
+    /** @brief Fast-path preprocessing via the iterative Euler-tour driver.
+     *
+     *  Same contract as the fused overload above, plus a caller-provided
+     *  arena; see LCA_tour_iterative for the descriptor requirements.
+     */
+    template <typename Graph, typename VertexIterator, typename IntegerContainer,
+              typename IndexIterator, typename IndexMultiArray>
+    // requires: Directed(Graph)
+    void LCA_preprocess(Graph const &data, VertexIterator Euler_tour_index,
+                        IntegerContainer &Euler_tour_level, IndexIterator representative,
+                        IndexMultiArray &sparse_table, LCA_tour_arena<Graph> &arena)
+    {
+        BOOST_ASSERT(num_vertices(data) == 0
+                     || Euler_tour_level.size() == 2 * num_vertices(data) - 1);
+
+        LCA_tour_iterative(data, Euler_tour_index, boost::begin(Euler_tour_level),
+                           representative, arena); // Θ(n)
+        general::RMQ_sparse_table(Euler_tour_level, sparse_table); // Θ(n lg n)
+    }
+
+
+    /** @brief Fused preprocessing as observed phases.
+     *
+     *  Same contract as the fused overload, reporting an "euler_tour" phase
+     *  (items = |V|) followed by the observed Sparse Table build; a
+     *  general::no_instrumentation observer compiles to the plain overload.
+     */
+    template <typename Graph, typename VertexIterator, typename IntegerContainer,
+              typename IndexIterator, typename IndexMultiArray, typename Observer>
+    // requires: Directed(Graph)
+    void LCA_preprocess(Graph const &data, VertexIterator Euler_tour_index,
+                        IntegerContainer &Euler_tour_level, IndexIterator representative,
+                        IndexMultiArray &sparse_table, Observer &observer)
+    {
+        typedef typename boost::graph_traits<Graph>::vertex_descriptor vertex_descriptor;
+
+        BOOST_ASSERT(num_vertices(data) == 0
+                     || Euler_tour_level.size() == 2 * num_vertices(data) - 1);
+
+        general::instrumented_phase(observer, "euler_tour", num_vertices(data), 0, 0, [&]
+        {
+            depth_first_search(data, boost::visitor(make_euler_tour<vertex_descriptor>(
+                Euler_tour_index, boost::begin(Euler_tour_level), representative)));
+        });
+        general::RMQ_sparse_table(Euler_tour_level, sparse_table, 1, observer);
+    }
+
+
     /** @brief Query the lowest common ancestor of two vertices.
      *  @param u First descendent vertex
      *  @param v Second descendent vertex
@@ -113,7 +314,8 @@ namespace graph_algorithms
     {
         // BOOST_CONCEPT_ASSERT((boost::RandomAccessContainer<RandomAccessVertexIterator>));
         // BOOST_CONCEPT_ASSERT((boost::RandomAccessContainer<VertexDepthContainer>));
-        BOOST_CONCEPT_ASSERT((boost::multi_array_concepts::ConstMultiArrayConcept<IndexMultiArray, 2>));
+        // NOTE: No multi-array concept check; any 2-d table indexable as t[j][i]
+        // will do, e.g. general::flat_table.
         typedef typename boost::range_value<IndexIndexable>::type Index;
 
         BOOST_ASSERT(u < representative.size());
@@ -128,46 +330,908 @@ namespace graph_algorithms
 
 
 
-    template <typename Graph>
+    /// Hint to the hardware to fetch the address into cache, where supported.
+    inline void prefetch(void const *address)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(address);
+#else
+        (void)address;
+#endif
+    }
+
+
+    /** @tparam Graph A Graph satisfying the VertexListGraph concept.
+     *  @tparam Level Storage type of Euler-tour levels; must hold the tree
+     *                height, so std::uint16_t suffices for most inputs.
+     *  @tparam Index Storage type of tour positions (representatives and
+     *                sparse-table entries); must hold 2n - 2.
+     *
+     *  Narrowing Level and Index halves (or better) the memory touched per
+     *  query relative to the std::size_t defaults; snapshots remain 64-bit
+     *  only.
+     */
+    template <typename Graph, typename Level = std::size_t, typename Index = std::size_t>
     class lowest_common_ancestor
     {
+    public:
+      /** Which RMQ engine answers queries on the Euler-tour levels.
+       *
+       *  sparse_table: the plain Sparse Table, Θ(n lg n) preprocessing space.
+       *  pm1: the ±1 block decomposition, O(n) preprocessing space.
+       */
+      enum class engine { sparse_table, pm1 };
+
     private:
       typedef typename boost::graph_traits<Graph>::vertex_descriptor vertex_descriptor;
-      typedef boost::multi_array_types::extent_range extent_range;
 
       std::vector<vertex_descriptor> Euler_tour_index_;
-      std::vector<std::size_t> Euler_tour_level_;
-      std::vector<std::size_t> representative_;
-      boost::multi_array<std::size_t, 2> sparse_table;
+      std::vector<Level> Euler_tour_level_;
+      std::vector<Index> representative_;
+      general::flat_table<Index> sparse_table_;
+      std::optional<general::pm1_range_minimum_query<std::vector<Level>>> pm1_rmq_;
+
+      // Owns a memory-mapped snapshot for instances loaded from disk.
+      struct snapshot_mapping
+      {
+        void *address = MAP_FAILED;
+        std::size_t length = 0;
+        int fd = -1;
+
+        ~snapshot_mapping()
+        {
+            if (address != MAP_FAILED)
+                munmap(address, length);
+            if (fd != -1)
+                close(fd);
+        }
+      };
+
+      // "LCAv1".
+      static std::uint64_t const snapshot_magic = 0x4c43417631ull;
+
+      // Leaves attached since preprocessing, resolved at query time and
+      // folded in by compact().
+      std::unordered_map<vertex_descriptor, vertex_descriptor> pending_parent_;
+      std::unordered_map<vertex_descriptor, std::size_t> pending_depth_;
+
+      std::shared_ptr<snapshot_mapping const> mapping_;
+      vertex_descriptor const *mapped_tour_index_ = nullptr;
+      Level const *mapped_tour_level_ = nullptr;
+      Index const *mapped_representative_ = nullptr;
+      Index const *mapped_table_ = nullptr;
+      std::size_t mapped_tour_length_ = 0;
 
     public:
-      lowest_common_ancestor(Graph const &tree)
-      : Euler_tour_index_(num_vertices(tree) > 2 ? 2 * num_vertices(tree) - 2 : num_vertices(tree)),
-        Euler_tour_level_(Euler_tour_index_.size()),
-        representative_(num_vertices(tree)),
-        sparse_table(general::sparse_table_extent(Euler_tour_index_.size()))
+      /** Where the preprocessed arrays live.
+       *
+       *  vectors: one std::vector per array.
+       *  arena: tour, levels, representatives and the Sparse Table carved
+       *  from a single anonymous mapping advised onto huge pages — one
+       *  allocation instead of four, and the arrays every query touches
+       *  share pages.  Sparse Table engine only.
+       */
+      enum class storage { vectors, arena };
+
+      lowest_common_ancestor(Graph const &tree, engine e = engine::sparse_table,
+                             storage s = storage::vectors)
+      {
+        std::size_t const n = num_vertices(tree);
+        std::size_t const m = n == 0 ? 0 : 2 * n - 1;
+        // The narrow variants must be able to hold every depth and position.
+        BOOST_ASSERT(n == 0 || (n - 1 <= std::numeric_limits<Level>::max()
+                                && m - 1 <= std::numeric_limits<Index>::max()));
+
+        if (s == storage::arena && m != 0)
+        {
+            // The pm1 engine owns its own block structures.
+            BOOST_ASSERT(e == engine::sparse_table);
+            vertex_descriptor *tour_index;
+            Level *tour_level;
+            Index *representative, *table;
+            allocate_arena(n, m, tour_index, tour_level, representative, table);
+            tour(tree, tour_index, tour_level, representative);
+            arena_row_view rows{table, m};
+            general::RMQ_sparse_table(tour_level, static_cast<std::ptrdiff_t>(m), rows);
+            return;
+        }
+
+        Euler_tour_index_.resize(m);
+        Euler_tour_level_.resize(m);
+        representative_.resize(n);
+        tour(tree, Euler_tour_index_.begin(), Euler_tour_level_.begin(),
+             representative_.begin());
+        if (e == engine::pm1)
+            pm1_rmq_.emplace(Euler_tour_level_);
+        else
+        {
+            sparse_table_.resize(general::sparse_table_rows(m), m);
+            general::RMQ_sparse_table(Euler_tour_level_, sparse_table_);
+        }
+      }
+
+      /** @brief Copying re-seats the ±1 engine on the copy's own levels.
+       *
+       *  pm1_range_minimum_query holds an iterator into Euler_tour_level_,
+       *  so a memberwise copy would leave the new engine reading the source
+       *  object's buffer — a use-after-free once the source is destroyed
+       *  or grown.  The block structures are rebuilt over the copied
+       *  levels, Θ(n); every other member is positional or shared and
+       *  copies as-is.
+       */
+      lowest_common_ancestor(lowest_common_ancestor const &other)
+          : Euler_tour_index_(other.Euler_tour_index_),
+            Euler_tour_level_(other.Euler_tour_level_),
+            representative_(other.representative_),
+            sparse_table_(other.sparse_table_),
+            pending_parent_(other.pending_parent_),
+            pending_depth_(other.pending_depth_),
+            mapping_(other.mapping_),
+            mapped_tour_index_(other.mapped_tour_index_),
+            mapped_tour_level_(other.mapped_tour_level_),
+            mapped_representative_(other.mapped_representative_),
+            mapped_table_(other.mapped_table_),
+            mapped_tour_length_(other.mapped_tour_length_)
+      {
+        if (other.pm1_rmq_)
+            pm1_rmq_.emplace(Euler_tour_level_);
+      }
+
+      lowest_common_ancestor &operator=(lowest_common_ancestor const &other)
       {
-        LCA_preprocess(tree, boost::make_function_output_iterator(
-                     general::make_reflection(Euler_tour_index_.begin(),
-                                              representative_.begin())),
-                     Euler_tour_level_, sparse_table);
+        if (this != &other)
+        {
+            lowest_common_ancestor copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+      }
+
+      // Vector buffers are stable under move, so the engine's iterator
+      // remains valid in the destination.
+      lowest_common_ancestor(lowest_common_ancestor &&) = default;
+      lowest_common_ancestor &operator=(lowest_common_ancestor &&) = default;
+
+      /** @brief Serve queries directly out of a snapshot written by save().
+       *
+       *  The file is memory-mapped read-only and the arrays are used in
+       *  place, so cold start is the cost of an mmap rather than of
+       *  re-running the preprocessing.  The mapping is shared by copies.
+       */
+      explicit lowest_common_ancestor(std::string const &path)
+      {
+        static_assert(std::is_integral<vertex_descriptor>::value
+                      && sizeof(vertex_descriptor) == sizeof(std::uint64_t),
+                      "snapshots require 64-bit integral vertex descriptors");
+        static_assert(std::is_same<Level, std::size_t>::value
+                      && std::is_same<Index, std::size_t>::value,
+                      "snapshots store 64-bit words only");
+
+        auto const mapping = std::make_shared<snapshot_mapping>();
+        mapping->fd = open(path.c_str(), O_RDONLY);
+        if (mapping->fd == -1)
+            throw std::runtime_error("lowest_common_ancestor: cannot open " + path);
+        struct stat status;
+        if (fstat(mapping->fd, &status) == -1)
+            throw std::runtime_error("lowest_common_ancestor: cannot stat " + path);
+        mapping->length = status.st_size;
+        mapping->address = mmap(nullptr, mapping->length, PROT_READ, MAP_SHARED,
+                                mapping->fd, 0);
+        if (mapping->address == MAP_FAILED)
+            throw std::runtime_error("lowest_common_ancestor: cannot map " + path);
+
+        std::uint64_t const *words = static_cast<std::uint64_t const *>(mapping->address);
+        if (mapping->length < 4 * sizeof(std::uint64_t) || words[0] != snapshot_magic)
+            throw std::runtime_error("lowest_common_ancestor: not a snapshot: " + path);
+        std::size_t const n = words[1], m = words[2], rows = words[3];
+        if (mapping->length != (4 + 2 * m + n + rows * m) * sizeof(std::uint64_t))
+            throw std::runtime_error("lowest_common_ancestor: truncated snapshot: " + path);
+
+        mapped_tour_index_ = reinterpret_cast<vertex_descriptor const *>(words + 4);
+        mapped_tour_level_ = reinterpret_cast<Level const *>(words + 4 + m);
+        mapped_representative_ = reinterpret_cast<Index const *>(words + 4 + 2 * m);
+        mapped_table_ = reinterpret_cast<Index const *>(words + 4 + 2 * m + n);
+        mapped_tour_length_ = m;
+        mapping_ = mapping;
+      }
+
+      /** @brief Write a binary snapshot of the preprocessed state.
+       *
+       *  Covers the Sparse Table engine only; all arrays are stored as
+       *  64-bit words so the mmap constructor can use them in place.
+       */
+      void save(std::string const &path) const
+      {
+        static_assert(std::is_same<Level, std::size_t>::value
+                      && std::is_same<Index, std::size_t>::value,
+                      "snapshots store 64-bit words only");
+        BOOST_ASSERT(!pm1_rmq_);
+
+        std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+        if (!out)
+            throw std::runtime_error("lowest_common_ancestor: cannot write " + path);
+        auto const put = [&out](std::uint64_t const *data, std::size_t count)
+        {
+            out.write(reinterpret_cast<char const *>(data), count * sizeof(std::uint64_t));
+        };
+        std::uint64_t const header[4] = {snapshot_magic, representative_size(),
+                                         tour_length(), table_rows()};
+        put(header, 4);
+        std::vector<std::uint64_t> buffer(tour_index_data(), tour_index_data() + tour_length());
+        put(buffer.data(), buffer.size());
+        put(tour_level_data(), tour_length());
+        put(representative_data(), representative_size());
+        put(table_data(), table_rows() * tour_length());
+        if (!out)
+            throw std::runtime_error("lowest_common_ancestor: cannot write " + path);
+      }
+
+      /** @brief Small per-thread cache for heavily repeated query pairs.
+       *
+       *  A direct-mapped, open-addressed table keyed on the canonicalized
+       *  (min, max) pair; a hit skips the representative/table/tour chain
+       *  entirely.  The default capacity keeps the entries within a typical
+       *  L2.  Answers never change — add_leaf only grows the tree and
+       *  compact() preserves ancestry — so entries need no invalidation,
+       *  and giving each query thread its own cache avoids coherence
+       *  traffic.
+       */
+      class query_cache
+      {
+        struct entry { vertex_descriptor u, v, ancestor; };
+
+        std::vector<entry> entries_;
+        std::size_t mask_;
+
+      public:
+        explicit query_cache(std::size_t capacity = 1u << 15)
+        {
+            std::size_t size = 1;
+            while (size < capacity)
+                size *= 2;
+            // u > v is unreachable for canonicalized keys, so empty slots
+            // can never hit.
+            entries_.assign(size, entry{1, 0, 0});
+            mask_ = size - 1;
+        }
+
+        entry &slot(vertex_descriptor u, vertex_descriptor v)
+        {
+            std::size_t const h = u * 0x9e3779b97f4a7c15ull
+                                ^ v * 0xc2b2ae3d27d4eb4full;
+            return entries_[(h >> 16) & mask_];
+        }
+      };
+
+      vertex_descriptor operator()(vertex_descriptor u, vertex_descriptor v,
+                                   query_cache &cache) const
+      {
+        if (v < u)
+            std::swap(u, v);
+        auto &cached = cache.slot(u, v);
+        if (cached.u == u && cached.v == v)
+            return cached.ancestor;
+        vertex_descriptor const ancestor = (*this)(u, v);
+        cached = {u, v, ancestor};
+        return ancestor;
       }
 
       vertex_descriptor operator()(vertex_descriptor u, vertex_descriptor v) const
       {
-        return lowest_common_ancestor_query(u, v, Euler_tour_index_, Euler_tour_level_,
-                                            representative_, sparse_table);
+        // Climb pending leaves into the preprocessed core first; the deeper
+        // endpoint is lifted, so a common pending ancestor is found exactly.
+        while (u != v && (is_pending(u) || is_pending(v)))
+        {
+            if (is_pending(u) && (!is_pending(v) || depth_of(v) <= depth_of(u)))
+                u = pending_parent_.find(u)->second;
+            else
+                v = pending_parent_.find(v)->second;
+        }
+        if (u == v)
+            return u;
+        std::size_t i = representative_data()[u], j = representative_data()[v];
+        if (j < i)
+            std::swap(i, j);
+        return tour_index_data()[rmq_index(i, j)];
+      }
+
+      /** @brief Attach a new leaf under parent without a full rebuild.
+       *  @param parent     An existing vertex (preprocessed or pending).
+       *  @param new_vertex The next unused vertex number.
+       *
+       *  The leaf is recorded in a side map and queries climb such pending
+       *  leaves into the preprocessed core, so an update is O(1) and a query
+       *  pays for the pending ancestry walked.  Once the pending leaves reach
+       *  a quarter of the core, compact() folds them in, amortizing the
+       *  Θ(n lg n) rebuild to polylogarithmic work per insertion.
+       */
+      void add_leaf(vertex_descriptor parent, vertex_descriptor new_vertex)
+      {
+        static_assert(std::is_integral<vertex_descriptor>::value,
+                      "add_leaf requires integral contiguous vertex descriptors");
+        BOOST_ASSERT(new_vertex == representative_size() + pending_parent_.size());
+        BOOST_ASSERT(parent < new_vertex);
+
+        pending_depth_[new_vertex] = depth_of(parent) + 1;
+        pending_parent_[new_vertex] = parent;
+        if (4 * pending_parent_.size() >= representative_size())
+            compact();
+      }
+
+      /** @brief Fold all pending leaves into the preprocessed structures.
+       *
+       *  Recovers the parents of the core from the Euler tour, merges the
+       *  pending leaves, and regenerates tour, levels, representatives and
+       *  the RMQ engine with one iterative traversal.  A mapped snapshot is
+       *  compacted into owned storage.
+       */
+      void compact()
+      {
+        if (pending_parent_.empty())
+            return;
+
+        std::size_t const n_core = representative_size();
+        std::size_t const n = n_core + pending_parent_.size();
+        std::size_t const old_length = tour_length();
+        vertex_descriptor const root = tour_index_data()[0];
+
+        std::vector<vertex_descriptor> parent(n);
+        for (std::size_t t = 1; t < old_length; t++)
+            if (tour_level_data()[t] == tour_level_data()[t - 1] + 1)
+                parent[tour_index_data()[t]] = tour_index_data()[t - 1];
+        for (auto const &leaf : pending_parent_)
+            parent[leaf.first] = leaf.second;
+
+        // Children of each vertex, in compressed sparse row form.
+        std::vector<std::size_t> offset(n + 1, 0);
+        for (std::size_t v = 0; v != n; v++)
+            if (v != root)
+                offset[parent[v] + 1]++;
+        std::partial_sum(offset.begin(), offset.end(), offset.begin());
+        std::vector<vertex_descriptor> child(n - 1);
+        std::vector<std::size_t> next(offset.begin(), offset.end() - 1);
+        for (std::size_t v = 0; v != n; v++)
+            if (v != root)
+                child[next[parent[v]]++] = v;
+        std::copy(offset.begin(), offset.end() - 1, next.begin());
+
+        bool const use_pm1 = static_cast<bool>(pm1_rmq_);
+        pm1_rmq_.reset();
+        mapping_.reset();
+
+        std::size_t const m = 2 * n - 1;
+        Euler_tour_index_.assign(m, root);
+        Euler_tour_level_.assign(m, 0);
+        representative_.assign(n, 0);
+        std::vector<vertex_descriptor> stack(1, root);
+        std::size_t position = 1;
+        while (!stack.empty())
+        {
+            vertex_descriptor const v = stack.back();
+            if (next[v] != offset[v + 1])
+            {
+                vertex_descriptor const c = child[next[v]++];
+                stack.push_back(c);
+                representative_[c] = position;
+                Euler_tour_index_[position] = c;
+                Euler_tour_level_[position] = stack.size() - 1;
+                position++;
+            }
+            else
+            {
+                stack.pop_back();
+                if (!stack.empty())
+                {
+                    Euler_tour_index_[position] = stack.back();
+                    Euler_tour_level_[position] = stack.size() - 1;
+                    position++;
+                }
+            }
+        }
+        BOOST_ASSERT(position == m);
+
+        pending_parent_.clear();
+        pending_depth_.clear();
+        if (use_pm1)
+            pm1_rmq_.emplace(Euler_tour_level_);
+        else
+        {
+            sparse_table_.resize(general::sparse_table_rows(m), m);
+            general::RMQ_sparse_table(Euler_tour_level_, sparse_table_);
+        }
+      }
+
+      /** @brief Answer a batch of LCA queries with cache-aware scheduling.
+       *  @param first   Beginning of pairs of descendent vertices.
+       *  @param last    End of pairs.
+       *  @param result  Output iterator; one ancestor per pair, in input order.
+       *
+       *  The queries are translated to Euler-tour ranges, sorted by lower
+       *  bound so that consecutive queries touch nearby parts of the level
+       *  sequence and sparse table, and answered with a software-prefetch
+       *  lookahead to keep several queries' cache misses in flight.
+       *
+       *  Time complexity: O(q lg q) scheduling, Θ(1) per query.
+       */
+      template <typename PairIterator, typename OutputIterator>
+      OutputIterator query_batch(PairIterator first, PairIterator last,
+                                 OutputIterator result) const
+      {
+        // Pending leaves would need climbing per query; take the scalar path.
+        if (!pending_parent_.empty())
+        {
+            for (; first != last; ++first)
+                *result++ = (*this)(first->first, first->second);
+            return result;
+        }
+
+        struct scheduled { std::size_t i, j, position; };
+        std::vector<scheduled> queries;
+        queries.reserve(std::distance(first, last));
+        for (std::size_t p = 0; first != last; ++first, ++p)
+        {
+            std::size_t i = representative_data()[first->first],
+                        j = representative_data()[first->second];
+            if (j < i)
+                std::swap(i, j);
+            queries.push_back(scheduled{i, j, p});
+        }
+        std::sort(queries.begin(), queries.end(),
+                  [](scheduled const &a, scheduled const &b){ return a.i < b.i; });
+
+        std::size_t const lookahead = 8;
+        std::vector<vertex_descriptor> answer(queries.size());
+        for (std::size_t q = 0; q != queries.size(); q++)
+        {
+            if (q + lookahead < queries.size())
+            {
+                scheduled const &ahead = queries[q + lookahead];
+                prefetch(tour_level_data() + ahead.i);
+                prefetch(tour_level_data() + ahead.j);
+                if (!pm1_rmq_ && ahead.j - ahead.i > 1)
+                {
+                    char const k = general::lower_log2(ahead.j - ahead.i + 1);
+                    prefetch(table_data() + (k - 1) * tour_length() + ahead.i);
+                }
+            }
+            scheduled const &query = queries[q];
+            answer[query.position] = tour_index_data()[rmq_index(query.i, query.j)];
+        }
+        return std::copy(answer.begin(), answer.end(), result);
+      }
+
+      /** @brief An immutable, trivially copyable query handle.
+       *
+       *  Holds raw pointers into the frozen tour/level/representative/table
+       *  buffers and nothing else: operator() performs no allocation and no
+       *  mutation, so any number of threads may query one view (or their own
+       *  copies — copying is a handful of words) without synchronization.
+       *  The view is valid as long as the lowest_common_ancestor it came
+       *  from is alive and not modified (add_leaf/compact invalidate it).
+       */
+      struct frozen_view
+      {
+        vertex_descriptor const *tour_index;
+        Level const *tour_level;
+        Index const *representative;
+        Index const *table;
+        std::size_t tour_length;
+        std::size_t n;
+
+        vertex_descriptor operator()(vertex_descriptor u, vertex_descriptor v) const
+        {
+            BOOST_ASSERT(u < n);
+            BOOST_ASSERT(v < n);
+            std::size_t i = representative[u], j = representative[v];
+            if (j < i)
+                std::swap(i, j);
+            if (i == j)
+                return tour_index[i];
+            if (j - i == 1)
+                return tour_index[tour_level[j] < tour_level[i] ? j : i];
+            char const k = general::lower_log2(j - i + 1);
+            std::size_t const l = j - general::pow2(k) + 1;
+            Index const *row = table + (k - 1) * tour_length;
+            std::size_t const x = row[i], y = row[l];
+            return tour_index[tour_level[y] < tour_level[x] ? y : x];
+        }
+      };
+
+      /** @brief Freeze the preprocessed state into a concurrent query handle.
+       *
+       *  Sparse Table engine only, and all pending leaves must have been
+       *  folded in (compact()) first.
+       */
+      frozen_view freeze() const
+      {
+        BOOST_ASSERT(!pm1_rmq_);
+        BOOST_ASSERT(pending_parent_.empty());
+        return frozen_view{tour_index_data(), tour_level_data(),
+                           representative_data(), table_data(),
+                           tour_length(), representative_size()};
       }
 
       std::vector<vertex_descriptor> const &Euler_tour_index() const
       { return Euler_tour_index_; }
 
-      std::vector<std::size_t> const &Euler_tour_level() const
+      std::vector<Level> const &Euler_tour_level() const
       { return Euler_tour_level_; }
 
-      std::vector<std::size_t> const &representative() const
+      std::vector<Index> const &representative() const
       { return representative_; }
 
+    private:
+      // The query path reads through these accessors so that it serves
+      // equally from the owned vectors or from a mapped snapshot.
+      vertex_descriptor const *tour_index_data() const
+      { return mapping_ ? mapped_tour_index_ : Euler_tour_index_.data(); }
+
+      Level const *tour_level_data() const
+      { return mapping_ ? mapped_tour_level_ : Euler_tour_level_.data(); }
+
+      Index const *representative_data() const
+      { return mapping_ ? mapped_representative_ : representative_.data(); }
+
+      Index const *table_data() const
+      { return mapping_ ? mapped_table_ : sparse_table_.data(); }
+
+      std::size_t tour_length() const
+      { return mapping_ ? mapped_tour_length_ : Euler_tour_level_.size(); }
+
+      std::size_t representative_size() const
+      { return mapping_ ? (mapped_table_ - mapped_representative_) : representative_.size(); }
+
+      std::size_t table_rows() const
+      { return mapping_ ? general::sparse_table_rows(mapped_tour_length_) : sparse_table_.rows(); }
+
+      // One Euler tour, through whichever driver the vertex type allows.
+      template <typename TourIterator, typename LevelIterator, typename IndexIterator>
+      void tour(Graph const &tree, TourIterator tour_index, LevelIterator tour_level,
+                IndexIterator representative)
+      {
+        if constexpr (std::is_integral<vertex_descriptor>::value)
+        {
+            // Deep trees must not recurse through the BGL DFS machinery.
+            LCA_tour_arena<typename std::remove_const<Graph>::type> arena;
+            LCA_tour_iterative(tree, tour_index, tour_level, representative, arena);
+        }
+        else
+            depth_first_search(tree, boost::visitor(make_euler_tour<vertex_descriptor>(
+                tour_index, tour_level, representative)));
+      }
+
+      // Minimal row view so RMQ_sparse_table can build straight into the
+      // arena's table section.
+      struct arena_row_view
+      {
+        Index *data;
+        std::size_t stride;
+
+        Index *operator[](std::size_t row) const { return data + row * stride; }
+      };
+
+      /** Lay the four query-time arrays head-to-tail in one anonymous
+       *  mapping, advised onto huge pages.  Section order matches save(),
+       *  so the representative and table sections stay adjacent, which
+       *  representative_size() relies on; the mapped accessors then serve
+       *  arena instances with no code of their own.
+       */
+      void allocate_arena(std::size_t n, std::size_t m,
+                          vertex_descriptor *&tour_index, Level *&tour_level,
+                          Index *&representative, Index *&table)
+      {
+        std::size_t const rows = general::sparse_table_rows(m);
+        auto const align = [](std::size_t offset, std::size_t alignment)
+        { return (offset + alignment - 1) / alignment * alignment; };
+        std::size_t const level_offset = align(m * sizeof(vertex_descriptor), alignof(Level));
+        std::size_t const representative_offset =
+            align(level_offset + m * sizeof(Level), alignof(Index));
+        std::size_t const length = representative_offset + (n + rows * m) * sizeof(Index);
+
+        auto const mapping = std::make_shared<snapshot_mapping>();
+        mapping->length = length;
+        mapping->address = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping->address == MAP_FAILED)
+            throw std::runtime_error("lowest_common_ancestor: cannot allocate arena");
+#if defined(MADV_HUGEPAGE)
+        // Best effort; the single allocation stands on its own.
+        madvise(mapping->address, length, MADV_HUGEPAGE);
+#endif
+        char *const base = static_cast<char *>(mapping->address);
+        tour_index = reinterpret_cast<vertex_descriptor *>(base);
+        tour_level = reinterpret_cast<Level *>(base + level_offset);
+        representative = reinterpret_cast<Index *>(base + representative_offset);
+        table = representative + n;
+        mapped_tour_index_ = tour_index;
+        mapped_tour_level_ = tour_level;
+        mapped_representative_ = representative;
+        mapped_table_ = table;
+        mapped_tour_length_ = m;
+        mapping_ = mapping;
+      }
+
+      bool is_pending(vertex_descriptor u) const
+      { return pending_parent_.find(u) != pending_parent_.end(); }
+
+      std::size_t depth_of(vertex_descriptor u) const
+      {
+        auto const pending = pending_depth_.find(u);
+        if (pending != pending_depth_.end())
+            return pending->second;
+        return tour_level_data()[representative_data()[u]];
+      }
+
+      // Index of the minimum level on [i, j], whichever engine is in use.
+      // The Sparse Table case mirrors general::RMQ over the raw arrays, so
+      // it serves identically from owned vectors and mapped snapshots.
+      std::size_t rmq_index(std::size_t i, std::size_t j) const
+      {
+        if (pm1_rmq_)
+            return (*pm1_rmq_)(i, j);
+
+        BOOST_ASSERT(i <= j);
+        Level const *level = tour_level_data();
+        if (i == j)
+            return i;
+        if (j - i == 1)
+            return level[j] < level[i] ? j : i;
+        char const k = general::lower_log2(j - i + 1);
+        std::size_t const l = j - general::pow2(k) + 1;
+        Index const *row = table_data() + (k - 1) * tour_length();
+        std::size_t const x = row[i], y = row[l];
+        return level[y] < level[x] ? y : x;
+      }
+    };
+
+
+    /** @brief Rebuilds LCA structures for a stream of (small) trees without
+     *  steady-state allocation.
+     *
+     *  The lowest_common_ancestor constructor allocates four containers per
+     *  tree, which dominates the profile when thousands of session-sized
+     *  trees are preprocessed per second.  The builder owns all of that
+     *  storage — tour, levels, representatives, Sparse Table and the DFS
+     *  arena — and build() only resizes it, so once the buffers have grown
+     *  to the largest tree seen, rebuilds allocate nothing.
+     *
+     *  build() returns a frozen_view into the builder's buffers; it is valid
+     *  until the next build() or the builder's destruction.
+     */
+    template <typename Graph, typename Level = std::size_t, typename Index = std::size_t>
+    class LCA_builder
+    {
+      typedef typename boost::graph_traits<Graph>::vertex_descriptor vertex_descriptor;
+
+      static_assert(std::is_integral<vertex_descriptor>::value,
+                    "LCA_builder requires integral contiguous vertex descriptors");
+
+      LCA_tour_arena<typename std::remove_const<Graph>::type> arena_;
+      std::vector<vertex_descriptor> tour_index_;
+      std::vector<Level> tour_level_;
+      std::vector<Index> representative_;
+      general::flat_table<Index> table_;
+
+    public:
+      typedef typename lowest_common_ancestor<Graph, Level, Index>::frozen_view view;
+
+      view build(Graph const &tree)
+      {
+        std::size_t const n = num_vertices(tree);
+        std::size_t const m = n == 0 ? 0 : 2 * n - 1;
+        BOOST_ASSERT(n == 0 || (n - 1 <= std::numeric_limits<Level>::max()
+                                && m - 1 <= std::numeric_limits<Index>::max()));
+
+        tour_index_.resize(m);
+        tour_level_.resize(m);
+        representative_.resize(n);
+        LCA_tour_iterative(tree, tour_index_.begin(), tour_level_.begin(),
+                           representative_.begin(), arena_);
+        table_.resize(general::sparse_table_rows(m), m);
+        general::RMQ_sparse_table(tour_level_, table_);
+        return view{tour_index_.data(), tour_level_.data(), representative_.data(),
+                    table_.data(), m, n};
+      }
+
+      /** @brief Build with tour emission and Sparse Table rows as
+       *  overlapping pipeline stages.
+       *
+       *  The tour runs on the calling thread, publishing how many positions
+       *  it has written; a worker thread fills table rows behind it in a
+       *  cascade, since row zero needs only a prefix of the levels and each
+       *  further row only a prefix of the one before.  By the time the tour
+       *  finishes, most of the table is already built, so the Θ(n lg n)
+       *  table cost largely hides behind the traversal (or behind whatever
+       *  I/O is feeding it).
+       */
+      view build_pipelined(Graph const &tree)
+      {
+        std::size_t const n = num_vertices(tree);
+        std::size_t const m = n == 0 ? 0 : 2 * n - 1;
+        if (m <= 2)
+            return build(tree);
+        BOOST_ASSERT(n - 1 <= std::numeric_limits<Level>::max()
+                     && m - 1 <= std::numeric_limits<Index>::max());
+
+        tour_index_.resize(m);
+        tour_level_.resize(m);
+        representative_.resize(n);
+        std::size_t const rows = general::sparse_table_rows(m);
+        table_.resize(rows, m);
+
+        std::atomic<std::size_t> published(0);
+        Level const *const levels = tour_level_.data();
+        std::thread worker([&]
+        {
+            std::vector<std::size_t> filled(rows, 0);
+            std::size_t complete = 0;
+            while (complete != rows)
+            {
+                std::size_t const p = published.load(std::memory_order_acquire);
+                bool any = false;
+                complete = 0;
+                for (std::size_t r = 0; r != rows; r++)
+                {
+                    // Valid entries of row r span [0, m - 2^{r+1} + 1).
+                    std::size_t const length = m - general::pow2(r + 1) + 1;
+                    std::size_t const half = general::pow2(r);
+                    std::size_t const available = r == 0
+                        ? (p == 0 ? 0 : p - 1)
+                        : (filled[r - 1] < half ? 0 : filled[r - 1] - half);
+                    std::size_t const target = std::min(length, available);
+                    if (target > filled[r])
+                    {
+                        if (r == 0)
+                            general::detail::argmin_adjacent(levels, filled[0], target,
+                                                             table_[0]);
+                        else
+                            general::detail::argmin_merge(levels, table_[r - 1],
+                                                          table_[r - 1] + half,
+                                                          filled[r], target, table_[r]);
+                        filled[r] = target;
+                        any = true;
+                    }
+                    complete += filled[r] == length;
+                }
+                if (!any && complete != rows)
+                    std::this_thread::yield();
+            }
+        });
+        LCA_tour_iterative(tree, tour_index_.begin(), tour_level_.begin(),
+                           representative_.begin(), arena_, &published);
+        worker.join();
+        return view{tour_index_.data(), tour_level_.data(), representative_.data(),
+                    table_.data(), m, n};
+      }
+    };
+
+
+    /** @brief LCA structures built straight from a parent array.
+     *
+     *  Trees often arrive as flat parent indexes — vertex i's parent at
+     *  position i, the root its own parent — and materializing a BGL graph
+     *  from them doubles peak memory and adds a pointer-chasing pass before
+     *  preprocessing even starts.  This ingests the array directly: one
+     *  counting-sort pass groups children by parent, and an explicit-stack
+     *  tour over those groups writes the Euler tour, levels and
+     *  representatives, after which the Sparse Table is built as usual.
+     *
+     *  Like LCA_builder, the buffers are owned and only resized, so build()
+     *  can be called per tree without steady-state allocation.
+     *
+     *  Time complexity: Θ(n lg n) construction, Θ(1) query.
+     */
+    template <typename Vertex = std::size_t, typename Level = std::size_t,
+              typename Index = std::size_t>
+    class LCA_parent_array
+    {
+        static_assert(std::is_integral<Vertex>::value,
+                      "parent arrays index vertices by position");
+
+        std::vector<Vertex> tour_index_;
+        std::vector<Level> tour_level_;
+        std::vector<Index> representative_;
+        general::flat_table<Index> table_;
+        std::vector<Vertex> children_;
+        std::vector<Vertex> cursor_;
+
+    public:
+        LCA_parent_array() = default;
+
+        template <typename ParentIterator>
+        LCA_parent_array(ParentIterator parents, std::size_t n)
+        {
+            build(parents, n);
+        }
+
+        template <typename ParentRange>
+        explicit LCA_parent_array(ParentRange const &parents)
+        {
+            build(boost::begin(parents), std::size_t(boost::distance(parents)));
+        }
+
+        /** @brief (Re)build from a parent array, reusing the buffers.
+         *
+         *  requires: parents describes one tree, with parents[root] == root.
+         */
+        template <typename ParentIterator>
+        void build(ParentIterator parents, std::size_t n)
+        {
+            std::size_t const m = n == 0 ? 0 : 2 * n - 1;
+            BOOST_ASSERT(n == 0 || (n - 1 <= std::numeric_limits<Level>::max()
+                                    && m - 1 <= std::numeric_limits<Index>::max()));
+            tour_index_.resize(m);
+            tour_level_.resize(m);
+            representative_.resize(n);
+            table_.resize(general::sparse_table_rows(m), m);
+            if (n == 0)
+                return;
+
+            // Counting sort of children by parent: afterwards the children
+            // of p occupy [p == 0 ? 0 : cursor_[p - 1], cursor_[p]).
+            cursor_.assign(n + 1, 0);
+            children_.resize(n - 1);
+            std::size_t root = n;
+            for (std::size_t i = 0; i != n; i++)
+                if (std::size_t(parents[i]) == i)
+                {
+                    BOOST_ASSERT(root == n); // exactly one root
+                    root = i;
+                }
+                else
+                    cursor_[std::size_t(parents[i]) + 1]++;
+            BOOST_ASSERT(root != n);
+            std::partial_sum(cursor_.begin(), cursor_.end(), cursor_.begin());
+            for (std::size_t i = 0; i != n; i++)
+                if (i != root)
+                    children_[cursor_[std::size_t(parents[i])]++] = Vertex(i);
+
+            // Explicit-stack Euler tour over the child groups, as in
+            // LCA_tour_iterative but with no graph object behind it.
+            struct frame { Vertex vertex, next, last; };
+            std::vector<frame> stack;
+            std::size_t position = 0;
+            auto const emit = [&](Vertex v, std::size_t depth)
+            {
+                tour_index_[position] = v;
+                tour_level_[position] = Level(depth);
+                position++;
+            };
+            auto const first_child = [&](Vertex p)
+            {
+                return p == 0 ? Vertex(0) : cursor_[p - 1];
+            };
+
+            representative_[root] = 0;
+            emit(Vertex(root), 0);
+            stack.push_back(frame{Vertex(root), first_child(Vertex(root)),
+                                  cursor_[root]});
+            while (!stack.empty())
+            {
+                frame &top = stack.back();
+                if (top.next != top.last)
+                {
+                    Vertex const child = children_[top.next++];
+                    representative_[child] = Index(position);
+                    emit(child, stack.size());
+                    stack.push_back(frame{child, first_child(child), cursor_[child]});
+                }
+                else
+                {
+                    stack.pop_back();
+                    if (!stack.empty())
+                        emit(stack.back().vertex, stack.size() - 1);
+                }
+            }
+            // A parent cycle would leave tour positions unwritten.
+            BOOST_ASSERT(position == m);
+            general::RMQ_sparse_table(tour_level_, table_);
+        }
+
+        Vertex operator()(Vertex u, Vertex v) const
+        {
+            return LCA(u, v, tour_index_, tour_level_, representative_, table_);
+        }
     };
 }
 
@@ -0,0 +1,168 @@
+/*
+    Copyright (C) 2014  Jeremy W. Murphy <jeremy.william.murphy@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file numa_replication.hpp
+ * @brief Per-NUMA-node replication of read-only query structures.
+ */
+
+#ifndef NUMA_REPLICATION_HPP
+#define NUMA_REPLICATION_HPP
+
+#include <boost/assert.hpp>
+
+#include <cstddef>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace general
+{
+    /** @brief CPU-to-node map, read from sysfs.
+     *
+     *  On machines that do not expose a topology (or non-Linux mounts of
+     *  this header) detection degrades to one node holding every CPU, so
+     *  callers need no special case.
+     */
+    class numa_topology
+    {
+    public:
+        std::size_t nodes() const { return cpus_of_node_.size(); }
+
+        std::vector<unsigned> const &cpus(std::size_t node) const
+        { return cpus_of_node_[node]; }
+
+        /// Node of the CPU the calling thread is running on right now.
+        std::size_t local_node() const
+        {
+            int const cpu = sched_getcpu();
+            return cpu < 0 || std::size_t(cpu) >= node_of_cpu_.size()
+                ? 0 : node_of_cpu_[cpu];
+        }
+
+        static numa_topology detect()
+        {
+            numa_topology result;
+            for (std::size_t node = 0; ; node++)
+            {
+                std::ostringstream path;
+                path << "/sys/devices/system/node/node" << node << "/cpulist";
+                std::ifstream cpulist(path.str().c_str());
+                if (!cpulist)
+                    break;
+                std::vector<unsigned> cpus;
+                // Format: comma-separated ranges, e.g. "0-15,32-47".
+                std::string range;
+                while (std::getline(cpulist, range, ','))
+                {
+                    std::istringstream bounds(range);
+                    unsigned first = 0, last = 0;
+                    char dash;
+                    bounds >> first;
+                    if (bounds >> dash && dash == '-')
+                        bounds >> last;
+                    else
+                        last = first;
+                    for (unsigned cpu = first; cpu <= last; cpu++)
+                        cpus.push_back(cpu);
+                }
+                if (!cpus.empty())
+                    result.cpus_of_node_.push_back(cpus);
+            }
+            if (result.cpus_of_node_.empty())
+                result.cpus_of_node_.push_back(std::vector<unsigned>(1, 0));
+            for (std::size_t node = 0; node != result.cpus_of_node_.size(); node++)
+                for (unsigned const cpu : result.cpus_of_node_[node])
+                {
+                    if (result.node_of_cpu_.size() <= cpu)
+                        result.node_of_cpu_.resize(cpu + 1, 0);
+                    result.node_of_cpu_[cpu] = node;
+                }
+            return result;
+        }
+
+    private:
+        std::vector<std::vector<unsigned>> cpus_of_node_;
+        std::vector<std::size_t> node_of_cpu_;
+    };
+
+
+    /** @brief One replica of a read-only structure per NUMA node.
+     *
+     *  Each replica is built by a thread pinned to its node's CPUs, so
+     *  first-touch policy places every page of the structure — tables,
+     *  tours, pools — on that node; local() then routes the calling thread
+     *  to the replica of the node it is running on, restoring uniform
+     *  query latency across sockets.  Pinning is best effort: if affinity
+     *  cannot be set the replica is still correct, merely possibly remote.
+     *
+     *  The factory must be safe to invoke concurrently, once per node.
+     *  On a single-node machine exactly one replica is built.
+     */
+    template <typename Structure>
+    class numa_replicated
+    {
+    public:
+        template <typename Factory>
+        explicit numa_replicated(Factory const &build)
+            : topology_(numa_topology::detect()),
+              replicas_(topology_.nodes())
+        {
+            std::vector<std::thread> builders;
+            builders.reserve(topology_.nodes());
+            for (std::size_t node = 0; node != topology_.nodes(); node++)
+                builders.emplace_back([this, node, &build]
+                {
+                    cpu_set_t cpus;
+                    CPU_ZERO(&cpus);
+                    for (unsigned const cpu : topology_.cpus(node))
+                        if (cpu < CPU_SETSIZE)
+                            CPU_SET(cpu, &cpus);
+                    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+                    replicas_[node] = std::make_shared<Structure const>(build());
+                });
+            for (std::thread &builder : builders)
+                builder.join();
+        }
+
+        /// The replica on the calling thread's node.
+        Structure const &local() const
+        {
+            return *replicas_[topology_.local_node()];
+        }
+
+        std::size_t replicas() const { return replicas_.size(); }
+
+        Structure const &replica(std::size_t node) const
+        {
+            BOOST_ASSERT(node < replicas_.size());
+            return *replicas_[node];
+        }
+
+    private:
+        numa_topology topology_;
+        std::vector<std::shared_ptr<Structure const>> replicas_;
+    };
+}
+
+#endif
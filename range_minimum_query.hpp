@@ -27,6 +27,8 @@
 // #include <boost/concept/requires.hpp>
 // #include <boost/concept/assert.hpp>
 
+#include <flat_table.hpp>
+#include <instrumentation.hpp>
 #include <integer_math.hpp>
 
 #include <boost/config.hpp>
@@ -38,7 +40,26 @@
 #include <boost/core/enable_if.hpp>
 
 #include <algorithm>
+#include <array>
+#include <cstdint>
+#include <fstream>
 #include <iterator>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 
 
@@ -48,44 +69,165 @@ namespace general
      * @defgroup RMQ_algorithms Range minimum query
      * @ingroup non_mutating_algorithms
      */
-    
-    
+
+
+    namespace detail
+    {
+        // Branch-free kernels for Sparse Table construction over contiguous
+        // storage.  The generic forms compile to compare-select sequences
+        // the optimizer can vectorize; the AVX2 overloads below take over
+        // for 32-bit data when the compiler targets it.
+
+        /// row[i] = leftmost argmin of {values[i], values[i + 1]}.
+        template <typename T, typename N, typename I>
+        inline void argmin_adjacent(T const *values, N lo, N hi, I *row)
+        {
+            for (N i = lo; i != hi; i++)
+                row[i] = i + (values[i + 1] < values[i]);
+        }
+
+        /// out[i] = whichever of left[i], right[i] indexes the smaller value,
+        /// preferring left on ties.
+        template <typename T, typename N, typename I>
+        inline void argmin_merge(T const *values, I const *left, I const *right,
+                                 N lo, N hi, I *out)
+        {
+            for (N i = lo; i != hi; i++)
+            {
+                I const M1 = left[i], M2 = right[i];
+                out[i] = values[M2] < values[M1] ? M2 : M1;
+            }
+        }
+
+#if defined(__AVX2__)
+        inline void argmin_adjacent(std::int32_t const *values, std::ptrdiff_t lo,
+                                    std::ptrdiff_t hi, std::uint32_t *row)
+        {
+            __m256i const ramp = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+            std::ptrdiff_t i = lo;
+            for (; i + 8 <= hi; i += 8)
+            {
+                __m256i const a = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(values + i));
+                __m256i const b = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(values + i + 1));
+                __m256i index = _mm256_add_epi32(_mm256_set1_epi32(i), ramp);
+                // cmpgt yields -1 where the successor is strictly smaller.
+                index = _mm256_sub_epi32(index, _mm256_cmpgt_epi32(a, b));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(row + i), index);
+            }
+            for (; i != hi; i++)
+                row[i] = i + (values[i + 1] < values[i]);
+        }
+
+        inline void argmin_merge(std::int32_t const *values, std::uint32_t const *left,
+                                 std::uint32_t const *right, std::ptrdiff_t lo,
+                                 std::ptrdiff_t hi, std::uint32_t *out)
+        {
+            std::ptrdiff_t i = lo;
+            for (; i + 8 <= hi; i += 8)
+            {
+                __m256i const M1 = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(left + i));
+                __m256i const M2 = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(right + i));
+                __m256i const v1 = _mm256_i32gather_epi32(values, M1, 4);
+                __m256i const v2 = _mm256_i32gather_epi32(values, M2, 4);
+                __m256i const take_right = _mm256_cmpgt_epi32(v1, v2);
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i),
+                                    _mm256_blendv_epi8(M1, M2, take_right));
+            }
+            for (; i != hi; i++)
+            {
+                std::uint32_t const M1 = left[i], M2 = right[i];
+                out[i] = values[M2] < values[M1] ? M2 : M1;
+            }
+        }
+#endif
+    }
+
+
+
     /**
      * @brief               Create a Sparse Table of indexes for RMQ from the input container A.
      * @ingroup             RMQ_algorithms
      * @param range          Input range.
      * @param sparse_table  Metadata created to process queries on the range.
+     * @param n_threads     Number of threads to construct with.
      *
-     * Time complexity: O(n lg n)
+     * Time complexity: O(n lg n), O(n lg n / p) per thread.
      */
     template <typename Iterator, typename MultiArray>
     void RMQ_sparse_table(Iterator first,
                           typename std::iterator_traits<Iterator>::difference_type n,
-                          MultiArray sparse_table)
+                          MultiArray &sparse_table,
+                          unsigned n_threads = 1)
     {
         typedef typename std::iterator_traits<Iterator>::difference_type N;
 
         BOOST_ASSERT(n >= 0);
 
+        // Iterations of a level are independent, so each level can be
+        // partitioned across threads with a join between levels.
+        N const minimum_grain = 4096;
+        auto const for_each_position = [&](N last_pos, auto const &body)
+        {
+            unsigned const workers = n_threads == 0 ? 1 :
+                std::min<N>(n_threads, last_pos / minimum_grain + 1);
+            if (workers == 1)
+            {
+                body(N(0), last_pos);
+                return;
+            }
+            N const chunk = (last_pos + workers - 1) / workers;
+            std::vector<std::thread> pool;
+            pool.reserve(workers);
+            for (unsigned t = 0; t != workers; t++)
+            {
+                N const lo = t * chunk;
+                if (lo >= last_pos)
+                    break;
+                N const hi = std::min(last_pos, lo + chunk);
+                pool.emplace_back([&body, lo, hi]{ body(lo, hi); });
+            }
+            for (auto &worker : pool)
+                worker.join();
+        };
+
+        // Contiguous input and table rows route through the branch-free
+        // (and, where available, SIMD) kernels.
+        constexpr bool contiguous = std::is_pointer<Iterator>::value
+            && std::is_pointer<typename std::decay<decltype(sparse_table[0])>::type>::value;
+
         if (n > 2)
         {
-            for (N i = 0; i != n - 1; i++)
-                sparse_table[0][i] = first[i] <= first[i + 1] ? i : i + 1;
+            for_each_position(n - 1, [&](N lo, N hi)
+            {
+                if constexpr (contiguous)
+                    detail::argmin_adjacent(first, lo, hi, sparse_table[0]);
+                else
+                    for (N i = lo; i != hi; i++)
+                        sparse_table[0][i] = first[i] <= first[i + 1] ? i : i + 1;
+            });
 
             char const lowerlogn = lower_log2(n);
             N prev_block_length = 2;
-            
+
             for (char j = 2; j != lowerlogn + 1; j++)
             {
                 N const block_length = pow2(j);
                 N const last_pos = n - block_length + 1;
-                
-                for (N i = 0; i != last_pos; i++)
+
+                for_each_position(last_pos, [&](N lo, N hi)
                 {
-                    N const &M1 = sparse_table[j - 2][i],
-                            &M2 = sparse_table[j - 2][i + prev_block_length];
-                    sparse_table[j - 1][i] = first[M2] < first[M1] ? M2 : M1;
-                }
+                    if constexpr (contiguous)
+                        detail::argmin_merge(first, sparse_table[j - 2],
+                                             sparse_table[j - 2] + prev_block_length,
+                                             lo, hi, sparse_table[j - 1]);
+                    else
+                        for (N i = lo; i != hi; i++)
+                        {
+                            N const &M1 = sparse_table[j - 2][i],
+                                    &M2 = sparse_table[j - 2][i + prev_block_length];
+                            sparse_table[j - 1][i] = first[M2] < first[M1] ? M2 : M1;
+                        }
+                });
                 prev_block_length = block_length;
             }
         }
@@ -94,15 +236,34 @@ namespace general
 
 
     template <typename Iterator, typename MultiArray>
-    void RMQ_sparse_table(Iterator first, Iterator last, MultiArray sparse_table)
+    void RMQ_sparse_table(Iterator first, Iterator last, MultiArray &sparse_table)
     {
       return RMQ_sparse_table(first, last - first, sparse_table);
     }
 
     template <typename RandomAccessRange, typename MultiArray>
-    void RMQ_sparse_table(RandomAccessRange const &range, MultiArray sparse_table)
+    void RMQ_sparse_table(RandomAccessRange const &range, MultiArray &sparse_table,
+                          unsigned n_threads = 1)
     {
-        return RMQ_sparse_table(boost::begin(range), boost::end(range), sparse_table);
+        return RMQ_sparse_table(boost::begin(range), boost::distance(range),
+                                sparse_table, n_threads);
+    }
+
+
+    /** @brief Build the Sparse Table as one observed phase.
+     *
+     *  Reports "RMQ_sparse_table" with items = n and the resulting table
+     *  dimensions; with the default no_instrumentation observer this is
+     *  the plain overload above.
+     */
+    template <typename RandomAccessRange, typename MultiArray, typename Observer>
+    void RMQ_sparse_table(RandomAccessRange const &range, MultiArray &sparse_table,
+                          unsigned n_threads, Observer &observer)
+    {
+        std::size_t const n = boost::distance(range);
+        instrumented_phase(observer, "RMQ_sparse_table", n,
+                           n < 2 ? 0 : std::size_t(lower_log2(n)), n,
+                           [&]{ RMQ_sparse_table(range, sparse_table, n_threads); });
     }
 
 
@@ -123,7 +284,7 @@ namespace general
                                typename std::iterator_traits<RandomAccessIterator>::difference_type>::type
     RMQ(typename std::iterator_traits<RandomAccessIterator>::difference_type i,
         typename std::iterator_traits<RandomAccessIterator>::difference_type j,
-        RandomAccessIterator range, MultiArray sparse_table)
+        RandomAccessIterator range, MultiArray const &sparse_table)
     {
         // BOOST_CONCEPT_ASSERT((boost::RandomAccessContainer<RandomAccessRange>));
         // BOOST_CONCEPT_ASSERT((boost::multi_array_concepts::ConstMultiArrayConcept<MultiArray, 2>));
@@ -137,8 +298,9 @@ namespace general
         if (i == j)
             return i;
 
+        // Prefer the leftmost minimum, consistent with the Sparse Table.
         if (j - i == 1)
-            return range[i] < range[j] ? i : j;
+            return range[j] < range[i] ? j : i;
         
         N const r = j - i + 1;
         char const k = lower_log2(r);
@@ -156,7 +318,7 @@ namespace general
                               typename boost::range_difference<RandomAccessRange>::type>::type
     RMQ(typename boost::range_difference<RandomAccessRange>::type i,
         typename boost::range_difference<RandomAccessRange>::type j,
-        RandomAccessRange const &range, MultiArray sparse_table)
+        RandomAccessRange const &range, MultiArray const &sparse_table)
     {
         BOOST_ASSERT(i < boost::distance(range));
         return RMQ(i, j, boost::begin(range), sparse_table);
@@ -172,39 +334,634 @@ namespace general
     }
 
 
+    /// Number of Sparse Table levels for an input of length n.
+    template <typename Integer>
+    std::size_t sparse_table_rows(Integer n)
+    {
+      BOOST_ASSERT(n >= 0);
+      return n == 0 ? 0 : lower_log2(n);
+    }
+
+
     template <typename RandomAccessRange>
     class range_minimum_query
     {
     public:
       typedef typename boost::range_difference<RandomAccessRange>::type index_t;
 
-      range_minimum_query(RandomAccessRange const &range)
+      /** How the Sparse Table is stored.
+       *
+       *  row_major: one row per level, the layout the construction kernels
+       *  write.
+       *  tiled: all levels of tile_width consecutive positions stored
+       *  contiguously, backed by (best effort) huge pages.  A query probes
+       *  the same row at two positions but the row varies with the span, so
+       *  on tables much larger than the TLB reach a mixed-span query load
+       *  touches a fresh page per probe under row_major; a tile keeps every
+       *  level of a position neighbourhood in the same few pages.
+       */
+      enum class layout { row_major, tiled };
+
+      /** @param n_threads Number of threads to build the Sparse Table with;
+       *                   each level is partitioned across them.
+       */
+      range_minimum_query(RandomAccessRange const &range, unsigned n_threads = 1,
+                          layout l = layout::row_major)
           : first(boost::begin(range)),
-            sparse_table(sparse_table_extent(boost::distance(range)))
+            sparse_table(sparse_table_rows(boost::distance(range)), boost::distance(range))
       {
-        using boost::multi_array_types::index_range;
-        RMQ_sparse_table(range, sparse_table[boost::indices[index_range(0, sparse_table.shape()[0])]
-                                                           [index_range(0, sparse_table.shape()[1])]]);
+        RMQ_sparse_table(range, sparse_table, n_threads);
+        if (l == layout::tiled)
+            tile();
       }
 
       index_t operator()(index_t i, index_t j) const
       {
-        using boost::multi_array_types::index_range;
-        return RMQ(i, j, first, sparse_table[boost::indices[index_range(0, sparse_table.shape()[0])]
-                                                           [index_range(0, sparse_table.shape()[1])]]);
+        if (!tiled_)
+            return RMQ(i, j, first, sparse_table);
+
+        BOOST_ASSERT(i >= 0);
+        BOOST_ASSERT(i <= j);
+        if (i == j)
+            return i;
+        if (j - i == 1)
+            return first[j] < first[i] ? j : i;
+        char const k = lower_log2(j - i + 1);
+        index_t const l = j - pow2(k) + 1;
+        index_t const x = tiled_entry(k - 1, i),
+                      y = tiled_entry(k - 1, l);
+        return first[y] < first[x] ? y : x;
       }
 
-    private:
+      /** @brief An immutable query handle over the frozen table.
+       *
+       *  Trivially copyable (when the range iterator is) and free of
+       *  per-call allocation or mutation, so threads can share one view or
+       *  copy it freely; valid while the parent range_minimum_query and the
+       *  underlying range are alive.
+       */
+      struct frozen_view
+      {
         typename boost::range_const_iterator<RandomAccessRange>::type first;
-        boost::multi_array<index_t, 2> sparse_table;
+        index_t const *table;
+        index_t columns;
+
+        index_t operator()(index_t i, index_t j) const
+        {
+            BOOST_ASSERT(i <= j);
+            if (i == j)
+                return i;
+            if (j - i == 1)
+                return first[j] < first[i] ? j : i;
+            char const k = lower_log2(j - i + 1);
+            index_t const l = j - pow2(k) + 1;
+            index_t const *row = table + (k - 1) * columns;
+            index_t const x = row[i], y = row[l];
+            return first[y] < first[x] ? y : x;
+        }
+      };
+
+      frozen_view freeze() const
+      {
+        // Views carry a row stride, which the tiled layout does not have.
+        BOOST_ASSERT(!tiled_);
+        return frozen_view{first, sparse_table.data(),
+                           static_cast<index_t>(sparse_table.columns())};
+      }
+
+    private:
+      // Entries per level in one tile: 512 levels-of-positions keep a whole
+      // tile of a 25-level table within two huge pages.
+      static std::size_t const tile_width = 512;
+      static std::size_t const hugepage = 2 * 1024 * 1024;
+
+      // Shared by copies; the table is immutable once built.
+      struct hugepage_buffer
+      {
+        index_t *data = nullptr;
+        std::size_t bytes = 0;
+
+        ~hugepage_buffer()
+        {
+            if (data)
+                munmap(data, bytes);
+        }
+      };
+
+      index_t tiled_entry(std::size_t k, index_t i) const
+      {
+        std::size_t const tile = i / tile_width;
+        return tiled_->data[(tile * rows_ + k) * tile_width + i % tile_width];
+      }
+
+      // Re-lay the row-major table into tiles on huge pages, then release
+      // the row-major storage.
+      void tile()
+      {
+        std::size_t const rows = sparse_table.rows(), columns = sparse_table.columns();
+        if (rows == 0 || columns == 0)
+            return;
+        std::size_t const tiles = (columns + tile_width - 1) / tile_width;
+        auto const buffer = std::make_shared<hugepage_buffer>();
+        buffer->bytes = (tiles * rows * tile_width * sizeof(index_t) + hugepage - 1)
+                        / hugepage * hugepage;
+        void *const address = mmap(nullptr, buffer->bytes, PROT_READ | PROT_WRITE,
+                                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (address == MAP_FAILED)
+            throw std::runtime_error("range_minimum_query: cannot allocate tiled table");
+        buffer->data = static_cast<index_t *>(address);
+#if defined(MADV_HUGEPAGE)
+        // Best effort; the layout stands on its own without huge pages.
+        madvise(address, buffer->bytes, MADV_HUGEPAGE);
+#endif
+        for (std::size_t k = 0; k != rows; k++)
+        {
+            index_t const *row = sparse_table[k];
+            for (std::size_t i = 0; i != columns; i++)
+                buffer->data[(i / tile_width * rows + k) * tile_width + i % tile_width] = row[i];
+        }
+        rows_ = rows;
+        tiled_ = buffer;
+        sparse_table = flat_table<index_t>();
+      }
+
+      typename boost::range_const_iterator<RandomAccessRange>::type first;
+      flat_table<index_t> sparse_table;
+      std::shared_ptr<hugepage_buffer const> tiled_;
+      std::size_t rows_ = 0;
+    };
+
+    namespace detail
+    {
+        /// constexpr twin of lower_log2, for compile-time table extents.
+        constexpr std::size_t lower_log2_c(std::size_t n)
+        {
+            return n < 2 ? 0 : 1 + lower_log2_c(n / 2);
+        }
+    }
+
+
+    /** @brief Sparse Table RMQ over a compile-time extent.
+     *  @ingroup RMQ_algorithms
+     *  @tparam Value Element type of the range.
+     *  @tparam N Exact length of the range.
+     *
+     *  For small fixed windows the generic machinery costs more than the
+     *  data: a heap allocation per instance for the table and a runtime
+     *  lower_log2 per query.  Here the level count and table extents are
+     *  constexpr, storage is std::array so an instance can live on the
+     *  stack, indexes take the narrowest integer that holds N, and the log
+     *  of every possible query span comes from a table computed at compile
+     *  time, so a query is straight-line code.
+     *
+     *  Time complexity: <Θ(N lg N), Θ(1)>
+     */
+    template <typename Value, std::size_t N>
+    class static_range_minimum_query
+    {
+        static_assert(N != 0, "an empty range cannot be queried");
+
+    public:
+        typedef typename std::conditional<N <= (1ull << 8), std::uint8_t,
+                typename std::conditional<N <= (1ull << 16), std::uint16_t,
+                                          std::uint32_t>::type>::type index_t;
+
+        static constexpr std::size_t rows = N < 2 ? 0 : detail::lower_log2_c(N);
+
+        template <typename RandomAccessRange>
+        explicit static_range_minimum_query(RandomAccessRange const &range)
+        {
+            BOOST_ASSERT(std::size_t(boost::distance(range)) == N);
+            std::copy(boost::begin(range), boost::end(range), values_.begin());
+            if (N > 2)
+            {
+                // Same leftmost-minimum tie-break as RMQ_sparse_table.
+                for (std::size_t i = 0; i != N - 1; i++)
+                    table_[i] = values_[i] <= values_[i + 1] ? i : i + 1;
+                for (std::size_t k = 2; k != rows + 1; k++)
+                {
+                    std::size_t const half = std::size_t(1) << (k - 1);
+                    for (std::size_t i = 0; i != N - 2 * half + 1; i++)
+                    {
+                        index_t const M1 = table_[(k - 2) * N + i],
+                                      M2 = table_[(k - 2) * N + i + half];
+                        table_[(k - 1) * N + i] = values_[M2] < values_[M1] ? M2 : M1;
+                    }
+                }
+            }
+        }
+
+        index_t operator()(index_t i, index_t j) const
+        {
+            BOOST_ASSERT(i <= j);
+            BOOST_ASSERT(j < N);
+            if (i == j)
+                return i;
+            if (index_t(j - i) == index_t(1))
+                return values_[j] < values_[i] ? j : i;
+            std::size_t const k = span_log_.entry[j - i + 1];
+            index_t const l = index_t(j - (std::size_t(1) << k) + 1);
+            index_t const x = table_[(k - 1) * N + i], y = table_[(k - 1) * N + l];
+            return values_[y] < values_[x] ? y : x;
+        }
+
+        Value const &operator[](index_t i) const { return values_[i]; }
+
+    private:
+        struct span_log_table
+        {
+            std::uint8_t entry[N + 1];
+
+            constexpr span_log_table() : entry()
+            {
+                for (std::size_t s = 2; s != N + 1; s++)
+                    entry[s] = std::uint8_t(detail::lower_log2_c(s));
+            }
+        };
+
+        static constexpr span_log_table span_log_ = span_log_table();
+
+        std::array<Value, N> values_;
+        std::array<index_t, rows * N> table_;
     };
 
+    template <typename Value, std::size_t N>
+    constexpr typename static_range_minimum_query<Value, N>::span_log_table
+    static_range_minimum_query<Value, N>::span_log_;
+
+
     template <typename RandomAccessRange>
     range_minimum_query<RandomAccessRange>
     make_range_minimum_query(RandomAccessRange const &range)
     {
         return range_minimum_query<RandomAccessRange>(range);
     }
+
+
+    /**
+     * @brief   Range minimum query on a ±1 sequence in O(n) space.
+     * @ingroup RMQ_algorithms
+     * @tparam  RandomAccessRange Range whose adjacent elements differ by exactly one.
+     *
+     * The block decomposition of Bender and Farach-Colton (§5 of the paper
+     * cited in lowest_common_ancestor.hpp): the sequence is cut into blocks of
+     * (lg n)/2 elements, a Sparse Table is kept over the block minima only, and
+     * queries within a block are answered from lookup tables shared by all
+     * blocks with the same ±1 shape.  Preprocessing space is thereby O(n)
+     * rather than the Θ(n lg n) of the plain Sparse Table.
+     *
+     * Time complexity: <O(n), Θ(1)>
+     */
+    template <typename RandomAccessRange>
+    class pm1_range_minimum_query
+    {
+    public:
+      typedef typename boost::range_difference<RandomAccessRange>::type index_t;
+
+      pm1_range_minimum_query(RandomAccessRange const &range)
+          : first(boost::begin(range)), n(boost::distance(range)), block_size(1)
+      {
+        if (n == 0)
+            return;
+
+        block_size = std::max<index_t>(1, lower_log2(n) / 2);
+        index_t const n_blocks = (n + block_size - 1) / block_size;
+        block_minimum_position.resize(n_blocks);
+        block_minimum_value.resize(n_blocks);
+        block_table.resize(n_blocks);
+
+        std::map<std::uint32_t, index_t> distinct;
+        for (index_t b = 0; b != n_blocks; b++)
+        {
+            index_t const start = b * block_size;
+            index_t const length = std::min(block_size, n - start);
+            std::uint32_t signature = 0;
+            index_t minimum = start;
+            for (index_t t = 1; t != length; t++)
+            {
+                // requires: adjacent elements differ by exactly one.
+                BOOST_ASSERT(first[start + t] == first[start + t - 1] + 1
+                          || first[start + t] + 1 == first[start + t - 1]);
+                if (first[start + t - 1] < first[start + t])
+                    signature |= std::uint32_t(1) << (t - 1);
+                else if (first[start + t] < first[minimum])
+                    minimum = start + t;
+            }
+            auto const result = distinct.insert(std::make_pair(signature, index_t(distinct.size())));
+            if (result.second)
+                append_in_block_table(signature);
+            block_table[b] = result.first->second;
+            block_minimum_position[b] = minimum;
+            block_minimum_value[b] = first[minimum];
+        }
+
+        sparse_table.resize(sparse_table_rows(n_blocks), n_blocks);
+        RMQ_sparse_table(block_minimum_value, sparse_table);
+      }
+
+      index_t operator()(index_t i, index_t j) const
+      {
+        // requires: [i, j] is a valid range.
+        BOOST_ASSERT(i >= 0);
+        BOOST_ASSERT(i <= j);
+        BOOST_ASSERT(j < n);
+
+        index_t const bi = i / block_size, bj = j / block_size;
+        if (bi == bj)
+            return bi * block_size + in_block(bi, i - bi * block_size, j - bi * block_size);
+
+        index_t minimum = bi * block_size + in_block(bi, i - bi * block_size, block_size - 1);
+        if (bi + 1 != bj)
+        {
+            index_t const middle = RMQ(bi + 1, bj - 1, block_minimum_value, sparse_table);
+            index_t const candidate = block_minimum_position[middle];
+            if (first[candidate] < first[minimum])
+                minimum = candidate;
+        }
+        index_t const candidate = bj * block_size + in_block(bj, 0, j - bj * block_size);
+        return first[candidate] < first[minimum] ? candidate : minimum;
+      }
+
+    private:
+      // Leftmost in-block minimum of [p, q] in block b, relative to the block.
+      index_t in_block(index_t b, index_t p, index_t q) const
+      {
+        return in_block_tables[(block_table[b] * block_size + p) * block_size + q];
+      }
+
+      // Tabulate in-block queries for a ±1 shape not seen before.
+      void append_in_block_table(std::uint32_t signature)
+      {
+        std::vector<long> value(block_size);
+        for (index_t t = 1; t != block_size; t++)
+            value[t] = value[t - 1] + (signature >> (t - 1) & 1 ? 1 : -1);
+        std::vector<unsigned char> row(block_size);
+        for (index_t p = 0; p != block_size; p++)
+        {
+            index_t minimum = p;
+            for (index_t q = p; q != block_size; q++)
+            {
+                if (value[q] < value[minimum])
+                    minimum = q;
+                row[q] = static_cast<unsigned char>(minimum);
+            }
+            in_block_tables.insert(in_block_tables.end(), row.begin(), row.end());
+        }
+      }
+
+      typename boost::range_const_iterator<RandomAccessRange>::type first;
+      index_t n;
+      index_t block_size;
+      std::vector<index_t> block_minimum_position;
+      std::vector<typename boost::range_value<RandomAccessRange>::type> block_minimum_value;
+      std::vector<index_t> block_table;
+      std::vector<unsigned char> in_block_tables;
+      flat_table<index_t> sparse_table;
+    };
+
+    template <typename RandomAccessRange>
+    pm1_range_minimum_query<RandomAccessRange>
+    make_pm1_range_minimum_query(RandomAccessRange const &range)
+    {
+        return pm1_range_minimum_query<RandomAccessRange>(range);
+    }
+
+
+    /**
+     * @brief   Range minimum query built from streamed chunks.
+     * @ingroup RMQ_algorithms
+     * @tparam  Value Element type; trivially copyable so chunks can spill.
+     *
+     * For inputs too large to hold (or table) in memory at once: the input
+     * is consumed through append() in chunks of chunk_size elements, each
+     * chunk gets its own Sparse Table, and one top-level Sparse Table is
+     * kept over the chunk minima.  A query combines at most two chunk-local
+     * lookups with one top-level lookup.  With a spill path, sealed chunks
+     * (values and table) are written to that file and memory-mapped by
+     * finish(), so resident memory is one open chunk plus the top-level
+     * arrays and the page cache decides which chunks stay hot.
+     *
+     * Time complexity: <O(n lg c), Θ(1)> for chunk size c.
+     */
+    template <typename Value>
+    class chunked_range_minimum_query
+    {
+        static_assert(std::is_trivially_copyable<Value>::value,
+                      "chunks are stored and spilled as raw bytes");
+
+    public:
+        explicit chunked_range_minimum_query(std::size_t chunk_size,
+                                             std::string spill_path = std::string())
+            : chunk_size_(chunk_size), spill_path_(spill_path)
+        {
+            BOOST_ASSERT(chunk_size >= 2);
+            if (!spill_path_.empty())
+            {
+                spill_.open(spill_path_.c_str(), std::ios::binary | std::ios::trunc);
+                if (!spill_)
+                    throw std::runtime_error("chunked_range_minimum_query: cannot write " + spill_path_);
+            }
+        }
+
+        /// Consume the next stretch of the input, in order.
+        template <typename InputRange>
+        void append(InputRange const &values)
+        {
+            BOOST_ASSERT(!finished_);
+            for (auto const &x : values)
+            {
+                open_chunk_.push_back(x);
+                n_++;
+                if (open_chunk_.size() == chunk_size_)
+                    seal();
+            }
+        }
+
+        /// Seal the trailing chunk and build the top-level table.
+        void finish()
+        {
+            BOOST_ASSERT(!finished_);
+            if (!open_chunk_.empty())
+                seal();
+            if (!spill_path_.empty())
+            {
+                spill_.close();
+                if (!spill_)
+                    throw std::runtime_error("chunked_range_minimum_query: cannot write " + spill_path_);
+                map_spill();
+            }
+            top_table_.resize(sparse_table_rows(chunk_minimum_value_.size()),
+                              chunk_minimum_value_.size());
+            RMQ_sparse_table(chunk_minimum_value_, top_table_);
+            finished_ = true;
+        }
+
+        /// Global index of the leftmost minimum on [i, j].
+        std::size_t operator()(std::size_t i, std::size_t j) const
+        {
+            BOOST_ASSERT(finished_);
+            BOOST_ASSERT(i <= j);
+            BOOST_ASSERT(j < n_);
+
+            std::size_t const ci = i / chunk_size_, cj = j / chunk_size_;
+            if (ci == cj)
+                return ci * chunk_size_ + local(ci, i - ci * chunk_size_, j - ci * chunk_size_);
+
+            std::size_t minimum = ci * chunk_size_
+                + local(ci, i - ci * chunk_size_, chunk_length(ci) - 1);
+            if (ci + 1 != cj)
+            {
+                std::size_t const middle = RMQ(ci + 1, cj - 1, chunk_minimum_value_, top_table_);
+                std::size_t const candidate = chunk_minimum_position_[middle];
+                if (value_at(candidate) < value_at(minimum))
+                    minimum = candidate;
+            }
+            std::size_t const candidate = cj * chunk_size_ + local(cj, 0, j - cj * chunk_size_);
+            return value_at(candidate) < value_at(minimum) ? candidate : minimum;
+        }
+
+        std::size_t size() const { return n_; }
+
+    private:
+        struct chunk_storage
+        {
+            std::vector<Value> values;
+            std::vector<std::uint32_t> table;
+        };
+
+        // Owns the spill file mapping; see lowest_common_ancestor snapshots
+        // for the same idiom.
+        struct spill_mapping
+        {
+            void *address = nullptr;
+            std::size_t length = 0;
+            int fd = -1;
+
+            ~spill_mapping()
+            {
+                if (address)
+                    munmap(address, length);
+                if (fd != -1)
+                    close(fd);
+            }
+        };
+
+        void seal()
+        {
+            std::size_t const length = open_chunk_.size();
+            chunk_storage sealed;
+            sealed.values.swap(open_chunk_);
+            sealed.table.resize(sparse_table_rows(length) * length);
+            flat_table<std::uint32_t> table(sparse_table_rows(length), length);
+            RMQ_sparse_table(sealed.values.data(),
+                             static_cast<std::ptrdiff_t>(length), table);
+            std::copy(table.data(), table.data() + table.size(), sealed.table.begin());
+
+            std::size_t minimum = 0;
+            for (std::size_t t = 1; t != length; t++)
+                if (sealed.values[t] < sealed.values[minimum])
+                    minimum = t;
+            // Every chunk before this one is full.
+            chunk_minimum_position_.push_back(chunk_size_ * chunk_lengths_.size() + minimum);
+            chunk_minimum_value_.push_back(sealed.values[minimum]);
+            chunk_lengths_.push_back(length);
+
+            if (spill_path_.empty())
+                chunks_.push_back(std::move(sealed));
+            else
+            {
+                value_offset_.push_back(spill_offset_);
+                write_spill(sealed.values.data(), length * sizeof(Value));
+                table_offset_.push_back(spill_offset_);
+                write_spill(sealed.table.data(),
+                            sealed.table.size() * sizeof(std::uint32_t));
+            }
+        }
+
+        void write_spill(void const *data, std::size_t bytes)
+        {
+            spill_.write(static_cast<char const *>(data), bytes);
+            spill_offset_ += bytes;
+            // Keep every section 8-byte aligned in the mapping.
+            std::size_t const padding = (8 - spill_offset_ % 8) % 8;
+            char const zero[8] = {};
+            spill_.write(zero, padding);
+            spill_offset_ += padding;
+        }
+
+        void map_spill()
+        {
+            auto const mapping = std::make_shared<spill_mapping>();
+            mapping->fd = open(spill_path_.c_str(), O_RDONLY);
+            if (mapping->fd == -1)
+                throw std::runtime_error("chunked_range_minimum_query: cannot open " + spill_path_);
+            struct stat status;
+            if (fstat(mapping->fd, &status) == -1)
+                throw std::runtime_error("chunked_range_minimum_query: cannot stat " + spill_path_);
+            mapping->length = status.st_size;
+            mapping->address = mmap(nullptr, mapping->length, PROT_READ, MAP_SHARED,
+                                    mapping->fd, 0);
+            if (mapping->address == MAP_FAILED)
+            {
+                mapping->address = nullptr;
+                throw std::runtime_error("chunked_range_minimum_query: cannot map " + spill_path_);
+            }
+            mapping_ = mapping;
+        }
+
+        Value const *chunk_values(std::size_t c) const
+        {
+            if (mapping_)
+                return reinterpret_cast<Value const *>(
+                    static_cast<char const *>(mapping_->address) + value_offset_[c]);
+            return chunks_[c].values.data();
+        }
+
+        std::uint32_t const *chunk_table(std::size_t c) const
+        {
+            if (mapping_)
+                return reinterpret_cast<std::uint32_t const *>(
+                    static_cast<char const *>(mapping_->address) + table_offset_[c]);
+            return chunks_[c].table.data();
+        }
+
+        std::size_t chunk_length(std::size_t c) const { return chunk_lengths_[c]; }
+
+        Value value_at(std::size_t i) const
+        { return chunk_values(i / chunk_size_)[i % chunk_size_]; }
+
+        // Leftmost argmin within chunk c; mirrors RMQ over the raw arrays.
+        std::size_t local(std::size_t c, std::size_t i, std::size_t j) const
+        {
+            BOOST_ASSERT(i <= j);
+            if (i == j)
+                return i;
+            Value const *values = chunk_values(c);
+            if (j - i == 1)
+                return values[j] < values[i] ? j : i;
+            char const k = lower_log2(j - i + 1);
+            std::size_t const l = j - pow2(k) + 1;
+            std::uint32_t const *row = chunk_table(c) + (k - 1) * chunk_length(c);
+            std::size_t const x = row[i], y = row[l];
+            return values[y] < values[x] ? y : x;
+        }
+
+        std::size_t chunk_size_;
+        std::size_t n_ = 0;
+        bool finished_ = false;
+        std::vector<Value> open_chunk_;
+        std::vector<chunk_storage> chunks_;
+        std::vector<std::size_t> chunk_lengths_;
+        std::vector<std::size_t> chunk_minimum_position_;
+        std::vector<Value> chunk_minimum_value_;
+        flat_table<std::size_t> top_table_;
+
+        std::string spill_path_;
+        std::ofstream spill_;
+        std::size_t spill_offset_ = 0;
+        std::vector<std::size_t> value_offset_, table_offset_;
+        std::shared_ptr<spill_mapping const> mapping_;
+    };
 }
 
 #endif
@@ -23,15 +23,22 @@
 #ifndef REFLECT_HPP
 #define REFLECT_HPP
 
+#include "instrumentation.hpp"
 #include "predicates.hpp"
 
 #include <boost/config.hpp>
 #include <boost/graph/breadth_first_search.hpp>
+#include <boost/graph/compressed_sparse_row_graph.hpp>
 #include <boost/graph/graph_concepts.hpp>
 #include <boost/graph/graph_traits.hpp>
 #include <boost/graph/transitive_closure.hpp>
 
+#include <algorithm>
+#include <numeric>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace graph_algorithms
 {
@@ -72,6 +79,44 @@ namespace graph_algorithms
     }
 
     
+    /** @brief Count every in-degree in one sweep over the edges.
+     *
+     *  The is_source predicate asks in_degree() per vertex, which on an
+     *  adjacency list is an O(degree) walk each time; one pass over the
+     *  edge list costs O(|V| + |E|) for all vertices together.  Requires
+     *  integral contiguous vertex descriptors.
+     */
+    template <typename EdgeListGraph>
+    std::vector<typename boost::graph_traits<EdgeListGraph>::vertices_size_type>
+    count_in_degrees(EdgeListGraph const &G)
+    {
+        typedef BOOST_DEDUCED_TYPENAME boost::graph_traits<EdgeListGraph>::edge_descriptor edge_descriptor;
+
+        std::vector<typename boost::graph_traits<EdgeListGraph>::vertices_size_type>
+            degree(num_vertices(G), 0);
+        auto const E = edges(G);
+        std::for_each(E.first, E.second, [&](edge_descriptor e){ degree[target(e, G)]++; });
+        return degree;
+    }
+
+
+    /** @brief Number of leading vertices with no in-edges.
+     *
+     *  The overloads below require the sources to be the lowest-numbered
+     *  vertices; this finds how many there are from the degree sweep.
+     */
+    template <typename EdgeListGraph>
+    typename boost::graph_traits<EdgeListGraph>::vertices_size_type
+    count_leading_sources(EdgeListGraph const &G)
+    {
+        auto const degree = count_in_degrees(G);
+        typename boost::graph_traits<EdgeListGraph>::vertices_size_type n_sources = 0;
+        while (n_sources != degree.size() && degree[n_sources] == 0)
+            n_sources++;
+        return n_sources;
+    }
+
+
     /** @brief Transform a graph G by adding its reversed reflection at the sources.
      *  @ingroup graph_algorithms
      *  @param G A Graph.
@@ -140,8 +185,7 @@ namespace graph_algorithms
         typedef BOOST_DEDUCED_TYPENAME boost::graph_traits<Graph>::edge_descriptor edge_descriptor;
         
         auto const V = vertices(G);
-        auto const source_last = find_if_not(V.first, V.second, std::bind(is_source(), _1, G));
-        auto const n_sources = distance(V.first, source_last);
+        auto const n_sources = count_leading_sources(G);
         unordered_map<vertex_descriptor, boost::default_color_type> vertex_color;
         boost::associative_property_map< decltype(vertex_color) > colour(vertex_color);
         for_each(V.first, V.second, [&](vertex_descriptor u){ put(colour, u, boost::white_color); });
@@ -161,6 +205,182 @@ namespace graph_algorithms
     {
         return reflect_through_sources(G, G);
     }
+
+
+    /** @brief Reflect as one observed phase.
+     *
+     *  Reports "reflect_through_sources" with items = |E(G)|; a
+     *  general::no_instrumentation observer compiles to the convenience
+     *  overload above.
+     */
+    template <typename Graph, typename MutableGraph, typename Observer>
+    typename boost::graph_traits<Graph>::vertices_size_type
+    reflect_through_sources(Graph const &G, MutableGraph &F, Observer &observer)
+    {
+        typename boost::graph_traits<Graph>::vertices_size_type offset = 0;
+        general::instrumented_phase(observer, "reflect_through_sources", num_edges(G), 0, 0,
+                                    [&]{ offset = reflect_through_sources(G, F); });
+        return offset;
+    }
+
+
+    /** @brief Scratch state for reflecting many graphs in sequence.
+     *
+     *  The convenience overload allocates a colour map and queue per call;
+     *  holding them here instead makes repeated reflections allocation-free
+     *  in the steady state, once the buffers have grown to the size of the
+     *  largest graph seen.  Requires integral contiguous vertex descriptors,
+     *  which is what lets the colour map be a plain vector.
+     */
+    template <typename Graph>
+    struct reflection_workspace
+    {
+        std::vector<boost::default_color_type> colour;
+        boost::queue<typename boost::graph_traits<Graph>::vertex_descriptor> q;
+    };
+
+
+    template <typename Graph, typename MutableGraph>
+    typename boost::graph_traits<Graph>::vertices_size_type
+    reflect_through_sources(Graph const &G, MutableGraph &F, reflection_workspace<Graph> &workspace)
+    {
+        using namespace std;
+        using std::placeholders::_1;
+
+        typedef BOOST_DEDUCED_TYPENAME boost::graph_traits<Graph>::vertex_descriptor vertex_descriptor;
+        typedef BOOST_DEDUCED_TYPENAME boost::graph_traits<Graph>::edge_descriptor edge_descriptor;
+
+        static_assert(std::is_integral<vertex_descriptor>::value,
+                      "reflection_workspace requires integral contiguous vertex descriptors");
+
+        auto const n_sources = count_leading_sources(G);
+        workspace.colour.assign(num_vertices(G), boost::white_color);
+        auto const colour = boost::make_iterator_property_map(workspace.colour.begin(),
+                                                              boost::identity_property_map());
+        if (static_cast<void const *>(&G) != static_cast<void const *>(&F))
+        {
+            auto const E = edges(G);
+            std::for_each(E.first, E.second, [&](edge_descriptor e){ add_edge(source(e, G), target(e, G), F); });
+        }
+        return reflect_through_sources(G, F, colour, workspace.q, n_sources);
+    }
+
+
+    /** @brief Reflect a graph through its sources into a freshly laid-out CSR graph.
+     *  @ingroup graph_algorithms
+     *  @param G A BidirectionalGraph that is also an EdgeListGraph.
+     *  @param F Compressed-sparse-row graph that receives both original and reflected edges.
+     *
+     *  Produces the same graph (and the same vertex numbering) as
+     *  reflect_through_sources(G, H) on a mutable H, but without any per-edge
+     *  allocation: the first pass over the edges of G counts the out-degree
+     *  of every vertex of F, the second writes the original and reflected
+     *  edges straight into their rows, already sorted by source.  The result
+     *  is immutable and ready for the closure stage.
+     *
+     *  Time complexity: O(|V| + |E|)
+     *
+     *  Requires: source vertices are the lowest-numbered vertices, and every
+     *  edge is reachable from a source (true of any DAG).
+     */
+    template <typename BidirectionalGraph, typename Directed, typename VertexProperty, typename EdgeProperty, typename GraphProperty, typename Vertex, typename EdgeIndex>
+    typename boost::graph_traits<BidirectionalGraph>::vertices_size_type
+    reflect_through_sources(BidirectionalGraph const &G, boost::compressed_sparse_row_graph<Directed, VertexProperty, EdgeProperty, GraphProperty, Vertex, EdgeIndex> &F)
+    {
+        using namespace boost;
+        using std::placeholders::_1;
+
+        typedef BOOST_DEDUCED_TYPENAME graph_traits<BidirectionalGraph>::vertex_descriptor vertex_descriptor;
+        typedef BOOST_DEDUCED_TYPENAME graph_traits<BidirectionalGraph>::vertices_size_type vertices_size_type;
+        typedef BOOST_DEDUCED_TYPENAME graph_traits<BidirectionalGraph>::edge_descriptor edge_descriptor;
+        typedef compressed_sparse_row_graph<Directed, VertexProperty, EdgeProperty, GraphProperty, Vertex, EdgeIndex> result_type;
+
+        BOOST_CONCEPT_ASSERT((BidirectionalGraphConcept<BidirectionalGraph>));
+        BOOST_CONCEPT_ASSERT((EdgeListGraphConcept<BidirectionalGraph>));
+
+        vertices_size_type const n_sources = count_leading_sources(G);
+        vertices_size_type const offset = num_vertices(G) - n_sources;
+        vertices_size_type const n = num_vertices(G) + offset;
+        // Sources merge with their reflections; every other vertex is offset.
+        auto const reflect = [&](vertex_descriptor u)
+        {
+            return u < n_sources ? u : u + offset;
+        };
+
+        auto const E = edges(G);
+        std::vector<vertices_size_type> cursor(n + 1, 0);
+        std::for_each(E.first, E.second, [&](edge_descriptor e)
+        {
+            ++cursor[source(e, G) + 1];
+            ++cursor[target(e, G) + offset + 1];
+        });
+        std::partial_sum(cursor.begin(), cursor.end(), cursor.begin());
+        typedef std::pair<vertices_size_type, vertices_size_type> vertex_pair;
+        std::vector<vertex_pair> edge_list(2 * num_edges(G));
+        std::for_each(E.first, E.second, [&](edge_descriptor e)
+        {
+            vertex_descriptor const x = source(e, G), y = target(e, G);
+            edge_list[cursor[x]++] = vertex_pair(x, y);
+            edge_list[cursor[y + offset]++] = vertex_pair(y + offset, reflect(x));
+        });
+        F = result_type(edges_are_sorted, edge_list.begin(), edge_list.end(), n, edge_list.size());
+        return offset;
+    }
+
+
+    /** @brief Reflect through an explicitly given set of sources.
+     *  @param reflected Out: reflected[v] is the vertex of F carrying the
+     *                   reflection of v — v itself for a source, a fresh
+     *                   vertex otherwise.
+     *
+     *  Lifts the numbering requirement of the other overloads: the sources
+     *  may be any vertices, so graphs arriving with arbitrary numbering no
+     *  longer need renumbering before reflection.  The remap plays the role
+     *  the uniform offset plays elsewhere, and reduces to it (reflected[v]
+     *  is v + offset for every non-source) when the sources do come first.
+     *
+     *  Time complexity: O(|V| + |E|)
+     */
+    template <typename BidirectionalGraph, typename SourceIterator, typename Directed, typename VertexProperty, typename EdgeProperty, typename GraphProperty, typename Vertex, typename EdgeIndex>
+    void reflect_through_sources(BidirectionalGraph const &G,
+                                 SourceIterator sources_first, SourceIterator sources_last,
+                                 boost::compressed_sparse_row_graph<Directed, VertexProperty, EdgeProperty, GraphProperty, Vertex, EdgeIndex> &F,
+                                 std::vector<typename boost::graph_traits<BidirectionalGraph>::vertices_size_type> &reflected)
+    {
+        using namespace boost;
+
+        typedef BOOST_DEDUCED_TYPENAME graph_traits<BidirectionalGraph>::vertex_descriptor vertex_descriptor;
+        typedef BOOST_DEDUCED_TYPENAME graph_traits<BidirectionalGraph>::vertices_size_type vertices_size_type;
+        typedef BOOST_DEDUCED_TYPENAME graph_traits<BidirectionalGraph>::edge_descriptor edge_descriptor;
+        typedef compressed_sparse_row_graph<Directed, VertexProperty, EdgeProperty, GraphProperty, Vertex, EdgeIndex> result_type;
+
+        vertices_size_type const n = num_vertices(G);
+        std::vector<char> is_a_source(n, false);
+        std::for_each(sources_first, sources_last,
+                      [&](vertex_descriptor u){ is_a_source[u] = true; });
+        reflected.resize(n);
+        vertices_size_type next = n;
+        for (vertices_size_type v = 0; v != n; v++)
+            reflected[v] = is_a_source[v] ? v : next++;
+
+        auto const E = edges(G);
+        std::vector<vertices_size_type> cursor(next + 1, 0);
+        std::for_each(E.first, E.second, [&](edge_descriptor e)
+        {
+            ++cursor[source(e, G) + 1];
+            ++cursor[reflected[target(e, G)] + 1];
+        });
+        std::partial_sum(cursor.begin(), cursor.end(), cursor.begin());
+        typedef std::pair<vertices_size_type, vertices_size_type> vertex_pair;
+        std::vector<vertex_pair> edge_list(2 * num_edges(G));
+        std::for_each(E.first, E.second, [&](edge_descriptor e)
+        {
+            vertex_descriptor const x = source(e, G), y = target(e, G);
+            edge_list[cursor[x]++] = vertex_pair(x, y);
+            edge_list[cursor[reflected[y]]++] = vertex_pair(reflected[y], reflected[x]);
+        });
+        F = result_type(edges_are_sorted, edge_list.begin(), edge_list.end(), next, edge_list.size());
+    }
 }
 
 #endif
@@ -30,7 +30,9 @@
 #include <boost/graph/adjacency_matrix.hpp>
 
 #include <iostream>
+#include <iterator>
 #include <locale>
+#include <numeric>
 
 using namespace graph_algorithms;
 
@@ -55,4 +57,118 @@ BOOST_AUTO_TEST_CASE(basic)
     BOOST_CHECK(!q.second);
 }
 
+BOOST_AUTO_TEST_CASE(observed_construction)
+{
+    DefaultAdjacencyList h(g);
+    boost::adjacency_matrix<> TC_F(17), TC_F2(17);
+    general::collecting_instrumentation stats;
+    auto const offset = create_common_ancestor_existence_tc(g, TC_F, stats);
+    auto const offset2 = create_common_ancestor_existence_tc(h, TC_F2);
+    BOOST_CHECK_EQUAL(offset, offset2);
+    BOOST_CHECK_EQUAL(num_edges(TC_F), num_edges(TC_F2));
+    BOOST_REQUIRE_EQUAL(stats.reports.size(), 3u);
+    BOOST_CHECK_EQUAL(stats.reports[0].phase, "reflect_through_sources");
+    BOOST_CHECK_EQUAL(stats.reports[1].phase, "transitive_closure");
+    BOOST_CHECK_EQUAL(stats.reports[2].phase, "closure_edges");
+    BOOST_CHECK_EQUAL(stats.reports[2].items, num_edges(TC_F));
+    BOOST_CHECK(stats.reports[0].seconds >= 0);
+}
+
+BOOST_AUTO_TEST_CASE(bitmaps_basic)
+{
+    ancestor_existence_bitmaps const index(g);
+    BOOST_CHECK(does_common_ancestor_exist(5, 9, index));
+    BOOST_CHECK(!does_common_ancestor_exist(5, 10, index));
+    BOOST_CHECK(does_common_ancestor_exist(8, 10, index));
+    BOOST_CHECK(!does_common_ancestor_exist(5, 6, index));
+}
+
+BOOST_AUTO_TEST_CASE(bulk_queries_agree)
+{
+    auto const n = num_vertices(g);
+    DefaultAdjacencyList h(g);
+    boost::adjacency_matrix<> TC_F(17);
+    auto const offset = create_common_ancestor_existence_tc(h, TC_F);
+    ancestor_existence_bitmaps const index(g);
+    // Sorted, reversed and scattered candidate orders all agree with the
+    // scalar query, over both representations.
+    std::vector<std::size_t> sorted(n);
+    std::iota(sorted.begin(), sorted.end(), 0);
+    std::vector<std::size_t> const reversed(sorted.rbegin(), sorted.rend());
+    std::vector<std::size_t> const scattered = {9, 0, 9, 5, 10, 2, 7, 7, 1};
+    for (auto const &order : {sorted, reversed, scattered})
+        for (std::size_t u = 0; u != n; u++)
+        {
+            std::vector<bool> from_graph, from_index;
+            common_ancestors_exist(u, order.begin(), order.end(), TC_F, offset,
+                                   std::back_inserter(from_graph));
+            common_ancestors_exist(u, order.begin(), order.end(), index,
+                                   std::back_inserter(from_index));
+            BOOST_REQUIRE_EQUAL(from_graph.size(), order.size());
+            BOOST_REQUIRE_EQUAL(from_index.size(), order.size());
+            for (std::size_t i = 0; i != order.size(); i++)
+            {
+                BOOST_CHECK_EQUAL(from_graph[i],
+                                  does_common_ancestor_exist(u, order[i], TC_F, offset));
+                BOOST_CHECK_EQUAL(from_index[i],
+                                  does_common_ancestor_exist(u, order[i], index));
+            }
+        }
+}
+
+BOOST_AUTO_TEST_CASE(bitmaps_parallel_construction_agrees)
+{
+    auto const n = num_vertices(g);
+    DefaultAdjacencyList h(g);
+    ancestor_existence_bitmaps const sequential(h), parallel(g, 4);
+    for (std::size_t u = 0; u != n; u++)
+        for (std::size_t v = 0; v != n; v++)
+            BOOST_CHECK_EQUAL(does_common_ancestor_exist(u, v, sequential),
+                              does_common_ancestor_exist(u, v, parallel));
+}
+
+BOOST_AUTO_TEST_CASE(bitmaps_agree_with_closure_graph)
+{
+    auto const n = num_vertices(g);
+    DefaultAdjacencyList h(g);
+    boost::adjacency_matrix<> TC_F(17);
+    auto const offset = create_common_ancestor_existence_tc(h, TC_F);
+    ancestor_existence_bitmaps const index(g);
+    BOOST_REQUIRE_EQUAL(offset, index.offset());
+    for (std::size_t u = 0; u != n; u++)
+        for (std::size_t v = 0; v != n; v++)
+            BOOST_CHECK_EQUAL(does_common_ancestor_exist(u, v, TC_F, offset),
+                              does_common_ancestor_exist(u, v, index));
+}
+
+BOOST_AUTO_TEST_CASE(bitmaps_from_csr_reflection_agree)
+{
+    auto const n = num_vertices(g);
+    DefaultAdjacencyList h(g);
+    boost::compressed_sparse_row_graph<boost::directedS> F;
+    auto const offset = reflect_through_sources(g, F);
+    ancestor_existence_bitmaps const mutable_path(h),
+        csr_path = ancestor_existence_bitmaps::from_reflected(F, offset);
+    BOOST_REQUIRE_EQUAL(mutable_path.offset(), csr_path.offset());
+    for (std::size_t u = 0; u != n; u++)
+        for (std::size_t v = 0; v != n; v++)
+            BOOST_CHECK_EQUAL(does_common_ancestor_exist(u, v, mutable_path),
+                              does_common_ancestor_exist(u, v, csr_path));
+}
+
+BOOST_AUTO_TEST_CASE(bitmaps_snapshot_round_trip)
+{
+    auto const n = num_vertices(g);
+    ancestor_existence_bitmaps const built(g);
+    std::string const path = "ancestor_existence.snapshot";
+    built.save(path);
+    ancestor_existence_bitmaps const loaded(path);
+    BOOST_REQUIRE_EQUAL(loaded.offset(), built.offset());
+    for (std::size_t u = 0; u != n; u++)
+        for (std::size_t v = 0; v != n; v++)
+            BOOST_CHECK_EQUAL(does_common_ancestor_exist(u, v, loaded),
+                              does_common_ancestor_exist(u, v, built));
+    std::remove(path.c_str());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
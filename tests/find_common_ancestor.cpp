@@ -36,6 +36,9 @@
 
 #include <iostream>
 #include <locale>
+#include <numeric>
+#include <random>
+#include <vector>
 
 using namespace graph_algorithms;
 
@@ -73,6 +76,73 @@ BOOST_FIXTURE_TEST_CASE(test_find_common_ancestor_single_use, Bender_2005_4<>)
     BOOST_CHECK_EQUAL(result.second, 2u);
 }
 
+BOOST_FIXTURE_TEST_CASE(test_find_common_ancestor_batch, Bender_2005_4<>)
+{
+    auto const V = boost::vertices(g);
+    std::vector<std::size_t> const sources = {0, 5, 1, 8};
+    typedef std::pair<decltype(V.first), std::size_t> relative;
+    std::vector<relative> expected;
+    for (auto const u : sources)
+        expected.push_back(find_common_ancestor(g, u, std::next(V.first, 6), V.second));
+
+    std::vector<relative> batched(sources.size());
+    find_common_ancestor_batch(g, sources.begin(), sources.end(),
+                               std::next(V.first, 6), V.second, batched.begin());
+    for (std::size_t i = 0; i != sources.size(); i++)
+    {
+        BOOST_CHECK(batched[i].first == expected[i].first);
+        BOOST_CHECK_EQUAL(batched[i].second, expected[i].second);
+    }
+
+    // Threaded workers give the same answers.
+    find_common_ancestor_batch(g, sources.begin(), sources.end(),
+                               std::next(V.first, 6), V.second, batched.begin(), 4);
+    for (std::size_t i = 0; i != sources.size(); i++)
+    {
+        BOOST_CHECK(batched[i].first == expected[i].first);
+        BOOST_CHECK_EQUAL(batched[i].second, expected[i].second);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_find_common_ancestor_batch_random_cross_check)
+{
+    // Random DAGs leave the shared worker state in varied shapes — hits
+    // with vertices still enqueued in particular — so every batch answer
+    // is cross-checked against an independent single-shot query.
+    std::mt19937 engine(23);
+    std::uniform_real_distribution<double> coin(0, 1);
+    for (int round = 0; round != 6; round++)
+    {
+        std::size_t const n = 60;
+        DefaultAdjacencyList g(n);
+        for (std::size_t u = 0; u != n; u++)
+            for (std::size_t v = u + 1; v != n; v++)
+                if (coin(engine) < 0.05)
+                    add_edge(u, v, g);
+        auto const V = boost::vertices(g);
+        std::vector<std::size_t> sources(n);
+        std::iota(sources.begin(), sources.end(), 0);
+        typedef std::pair<decltype(V.first), std::size_t> relative;
+        std::vector<relative> expected;
+        for (auto const u : sources)
+            expected.push_back(find_common_ancestor(g, u, std::next(V.first, n / 2), V.second));
+
+        std::vector<relative> batched(sources.size());
+        for (unsigned const n_threads : {1u, 4u})
+        {
+            find_common_ancestor_batch(g, sources.begin(), sources.end(),
+                                       std::next(V.first, n / 2), V.second,
+                                       batched.begin(), n_threads);
+            for (std::size_t i = 0; i != sources.size(); i++)
+            {
+                BOOST_CHECK(batched[i].first == expected[i].first);
+                if (expected[i].first != V.second)
+                    BOOST_CHECK_EQUAL(batched[i].second, expected[i].second);
+            }
+        }
+    }
+}
+
 BOOST_FIXTURE_TEST_CASE(test_find_common_ancestor_repeat_use, Bender_2005_4<>)
 {
     using namespace boost;
@@ -0,0 +1,40 @@
+#include <boost/config.hpp>
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <flat_table.hpp>
+
+using namespace general;
+
+BOOST_AUTO_TEST_CASE(empty_table)
+{
+    flat_table<std::size_t> t;
+    BOOST_CHECK(t.empty());
+    BOOST_CHECK_EQUAL(t.rows(), 0u);
+    BOOST_CHECK_EQUAL(t.columns(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(row_stride)
+{
+    flat_table<std::size_t> t(3, 5);
+    BOOST_CHECK_EQUAL(t.rows(), 3u);
+    BOOST_CHECK_EQUAL(t.columns(), 5u);
+    BOOST_CHECK_EQUAL(t.size(), 15u);
+    for (std::size_t j = 0; j != t.rows(); j++)
+        for (std::size_t i = 0; i != t.columns(); i++)
+            t[j][i] = j * t.columns() + i;
+    // Rows are contiguous in one allocation.
+    for (std::size_t k = 0; k != t.size(); k++)
+        BOOST_CHECK_EQUAL(t.data()[k], k);
+}
+
+BOOST_AUTO_TEST_CASE(resize_and_compare)
+{
+    flat_table<int> t;
+    t.resize(2, 4);
+    BOOST_CHECK_EQUAL(t.rows(), 2u);
+    flat_table<int> u(2, 4);
+    BOOST_CHECK(t == u);
+    u[1][3] = 7;
+    BOOST_CHECK(t != u);
+}
@@ -4,6 +4,7 @@
 
 #include "lowest_common_ancestor.hpp"
 #include "fixture.hpp"
+#include <numa_replication.hpp>
 #include <transformers.hpp>
 
 #ifndef NDEBUG
@@ -21,7 +22,9 @@
 #include <iostream>
 #include <locale>
 #include <functional>
+#include <numeric>
 #include <random>
+#include <thread>
 #include <unordered_map>
 
 using namespace std;
@@ -80,6 +83,89 @@ BOOST_AUTO_TEST_CASE(basic_preprocess)
     // BOOST_CHECK_EQUAL_COLLECTIONS(make_indirect_iterator(begin(T)), make_indirect_iterator(end(T)), begin(T_values), end(T_values));
 }
 
+BOOST_AUTO_TEST_CASE(fused_preprocess)
+{
+  int const n = num_vertices(g), m = 2 * n - 1;
+  vector<vertex_descriptor> Euler_tour_index(m), Euler_tour_index2(m);
+  vector<size_t> Euler_tour_level(m), representative(n), representative2(n);
+  boost::multi_array<size_t, 2> M(general::sparse_table_extent(m));
+  LCA_preprocess(g, Euler_tour_index.begin(), Euler_tour_level,
+                 representative.begin(), M);
+  BOOST_CHECK_EQUAL_COLLECTIONS(Euler_tour_index.begin(), Euler_tour_index.end(),
+                                this->E.begin(), this->E.end());
+  BOOST_CHECK_EQUAL_COLLECTIONS(Euler_tour_level.begin(), Euler_tour_level.end(),
+                                this->L.begin(), this->L.end());
+  // Representatives agree with the two-pass reflection path.
+  vector<size_t> Euler_tour_level2;
+  LCA_preprocess(g, boost::make_function_output_iterator(
+                          general::make_reflection(Euler_tour_index2.begin(),
+                          representative2.begin())), Euler_tour_level2, M);
+  BOOST_CHECK_EQUAL_COLLECTIONS(representative.begin(), representative.end(),
+                                representative2.begin(), representative2.end());
+}
+
+BOOST_AUTO_TEST_CASE(iterative_preprocess)
+{
+  int const n = num_vertices(g), m = 2 * n - 1;
+  vector<vertex_descriptor> Euler_tour_index(m);
+  vector<size_t> Euler_tour_level(m), representative(n);
+  boost::multi_array<size_t, 2> M(general::sparse_table_extent(m));
+  LCA_tour_arena<boost::adjacency_list<>> arena;
+  LCA_preprocess(g, Euler_tour_index.begin(), Euler_tour_level,
+                 representative.begin(), M, arena);
+  BOOST_CHECK_EQUAL_COLLECTIONS(Euler_tour_index.begin(), Euler_tour_index.end(),
+                                this->E.begin(), this->E.end());
+  BOOST_CHECK_EQUAL_COLLECTIONS(Euler_tour_level.begin(), Euler_tour_level.end(),
+                                this->L.begin(), this->L.end());
+  // The arena is reusable across runs.
+  LCA_preprocess(g, Euler_tour_index.begin(), Euler_tour_level,
+                 representative.begin(), M, arena);
+  BOOST_CHECK_EQUAL_COLLECTIONS(Euler_tour_level.begin(), Euler_tour_level.end(),
+                                this->L.begin(), this->L.end());
+}
+
+BOOST_AUTO_TEST_CASE(observed_preprocess)
+{
+  int const n = num_vertices(g), m = 2 * n - 1;
+  vector<vertex_descriptor> Euler_tour_index(m);
+  vector<size_t> Euler_tour_level(m), representative(n);
+  boost::multi_array<size_t, 2> M(general::sparse_table_extent(m));
+  general::collecting_instrumentation stats;
+  LCA_preprocess(g, Euler_tour_index.begin(), Euler_tour_level,
+                 representative.begin(), M, stats);
+  BOOST_CHECK_EQUAL_COLLECTIONS(Euler_tour_level.begin(), Euler_tour_level.end(),
+                                this->L.begin(), this->L.end());
+  BOOST_REQUIRE_EQUAL(stats.reports.size(), 2u);
+  BOOST_CHECK_EQUAL(stats.reports[0].phase, "euler_tour");
+  BOOST_CHECK_EQUAL(stats.reports[0].items, size_t(n));
+  BOOST_CHECK_EQUAL(stats.reports[1].phase, "RMQ_sparse_table");
+  BOOST_CHECK_EQUAL(stats.reports[1].items, size_t(m));
+  BOOST_CHECK_EQUAL(stats.reports[1].rows, size_t(general::lower_log2(m)));
+  BOOST_CHECK_EQUAL(stats.reports[1].columns, size_t(m));
+  BOOST_CHECK(stats.reports[0].seconds >= 0);
+  BOOST_CHECK(stats.reports[0].peak_rss_kb > 0);
+  // The default observer is a compile-time no-op.
+  general::no_instrumentation quiet;
+  LCA_preprocess(g, Euler_tour_index.begin(), Euler_tour_level,
+                 representative.begin(), M, quiet);
+  BOOST_CHECK_EQUAL_COLLECTIONS(Euler_tour_level.begin(), Euler_tour_level.end(),
+                                this->L.begin(), this->L.end());
+}
+
+BOOST_AUTO_TEST_CASE(deep_path_preprocess)
+{
+    // Deep enough that a recursive traversal would exhaust the call stack.
+    size_t const n = 300000;
+    boost::adjacency_list<> path;
+    for (size_t v = 1; v != n; v++)
+        add_edge(v - 1, v, path);
+    typedef lowest_common_ancestor<boost::adjacency_list<>> LCA;
+    LCA const lca(path, LCA::engine::pm1);
+    BOOST_CHECK_EQUAL(lca(0, n - 1), 0u);
+    BOOST_CHECK_EQUAL(lca(n - 1, n - 2), n - 2);
+    BOOST_CHECK_EQUAL(lca(1000, 299999), 1000u);
+}
+
 #if 0
 
 BOOST_AUTO_TEST_CASE(basic_query)
@@ -114,5 +200,328 @@ BOOST_AUTO_TEST_CASE(basic_query)
 
 #endif
 
+BOOST_AUTO_TEST_CASE(query_sparse_table_engine)
+{
+    lowest_common_ancestor<boost::adjacency_list<>> const lca(g);
+    BOOST_CHECK_EQUAL(lca(0, 0), 0u);
+    BOOST_CHECK_EQUAL(lca(0, 7), 0u);
+    BOOST_CHECK_EQUAL(lca(11, 12), 1u);
+    BOOST_CHECK_EQUAL(lca(17, 19), 4u);
+    BOOST_CHECK_EQUAL(lca(14, 16), 7u);
+    BOOST_CHECK_EQUAL(lca(12, 17), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(query_pm1_engine)
+{
+    typedef lowest_common_ancestor<boost::adjacency_list<>> LCA;
+    LCA const lca(g, LCA::engine::pm1);
+    BOOST_CHECK_EQUAL(lca(0, 0), 0u);
+    BOOST_CHECK_EQUAL(lca(0, 7), 0u);
+    BOOST_CHECK_EQUAL(lca(11, 12), 1u);
+    BOOST_CHECK_EQUAL(lca(17, 19), 4u);
+    BOOST_CHECK_EQUAL(lca(14, 16), 7u);
+    BOOST_CHECK_EQUAL(lca(12, 17), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(pm1_engine_copy_outlives_source)
+{
+    typedef lowest_common_ancestor<boost::adjacency_list<>> LCA;
+    // Copies of a pm1-engine instance must re-seat the engine on their own
+    // levels, not read the source object's buffer.
+    optional<LCA> source(LCA(g, LCA::engine::pm1));
+    LCA const copy(*source);
+    LCA assigned(g);
+    assigned = *source;
+    source.reset();
+    LCA const reference(g);
+    auto const n = num_vertices(g);
+    for (size_t u = 0; u != n; u++)
+        for (size_t v = 0; v != n; v++)
+        {
+            BOOST_CHECK_EQUAL(copy(u, v), reference(u, v));
+            BOOST_CHECK_EQUAL(assigned(u, v), reference(u, v));
+        }
+}
+
+BOOST_AUTO_TEST_CASE(arena_storage_agrees)
+{
+    typedef lowest_common_ancestor<boost::adjacency_list<>> LCA;
+    LCA const vectors(g);
+    LCA arena(g, LCA::engine::sparse_table, LCA::storage::arena);
+    auto const n = num_vertices(g);
+    for (size_t u = 0; u != n; u++)
+        for (size_t v = 0; v != n; v++)
+            BOOST_CHECK_EQUAL(arena(u, v), vectors(u, v));
+    // Growth falls back to owned storage through the usual compaction.
+    arena.add_leaf(19, 20);
+    BOOST_CHECK_EQUAL(arena(20, 17), 4u);
+    BOOST_CHECK_EQUAL(arena(20, 12), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(numa_replicated_agrees)
+{
+    typedef lowest_common_ancestor<boost::adjacency_list<>> LCA;
+    LCA const direct(g);
+    general::numa_replicated<LCA> const replicas([&]{ return LCA(g); });
+    BOOST_REQUIRE(replicas.replicas() >= 1);
+    auto const n = num_vertices(g);
+    // Every replica, not just the local one, answers identically.
+    for (size_t node = 0; node != replicas.replicas(); node++)
+        for (size_t u = 0; u != n; u++)
+            for (size_t v = 0; v != n; v++)
+                BOOST_CHECK_EQUAL(replicas.replica(node)(u, v), direct(u, v));
+    // local() is safe from concurrent threads on arbitrary CPUs.
+    vector<thread> readers;
+    vector<char> ok(4, 0);
+    for (int t = 0; t != 4; t++)
+        readers.emplace_back([&, t]
+        {
+            LCA const &lca = replicas.local();
+            ok[t] = lca(11, 12) == 1u && lca(17, 19) == 4u && lca(14, 16) == 7u;
+        });
+    for (thread &reader : readers)
+        reader.join();
+    for (char const passed : ok)
+        BOOST_CHECK(passed);
+}
+
+BOOST_AUTO_TEST_CASE(builder_reuse)
+{
+    typedef lowest_common_ancestor<boost::adjacency_list<>> LCA;
+    LCA const lca(g);
+    LCA_builder<boost::adjacency_list<>> builder;
+    auto const n = num_vertices(g);
+    {
+        auto const view = builder.build(g);
+        for (size_t u = 0; u != n; u++)
+            for (size_t v = 0; v != n; v++)
+                BOOST_CHECK_EQUAL(view(u, v), lca(u, v));
+    }
+    // A smaller tree reuses the grown buffers.
+    boost::adjacency_list<> path;
+    for (size_t v = 1; v != 5; v++)
+        add_edge(v - 1, v, path);
+    {
+        auto const view = builder.build(path);
+        BOOST_CHECK_EQUAL(view(0, 4), 0u);
+        BOOST_CHECK_EQUAL(view(3, 4), 3u);
+    }
+    // And back to the original, to catch stale state.
+    auto const view = builder.build(g);
+    for (size_t u = 0; u != n; u++)
+        for (size_t v = 0; v != n; v++)
+            BOOST_CHECK_EQUAL(view(u, v), lca(u, v));
+}
+
+BOOST_AUTO_TEST_CASE(parent_array_agrees)
+{
+    // The same tree as a flat parent array, no graph object involved.
+    auto const n = num_vertices(g);
+    vector<size_t> parents(n);
+    auto const E_g = edges(g);
+    for_each(E_g.first, E_g.second, [&](boost::graph_traits<boost::adjacency_list<>>::edge_descriptor e)
+    {
+        parents[target(e, g)] = source(e, g);
+    });
+    parents[0] = 0; // the root is its own parent
+    lowest_common_ancestor<boost::adjacency_list<>> const reference(g);
+    LCA_parent_array<> const direct(parents);
+    for (size_t u = 0; u != n; u++)
+        for (size_t v = 0; v != n; v++)
+            BOOST_CHECK_EQUAL(direct(u, v), reference(u, v));
+    // Rebuilding reuses the buffers, as with LCA_builder.
+    LCA_parent_array<> lca;
+    lca.build(parents.begin(), parents.size());
+    BOOST_CHECK_EQUAL(lca(17, 19), 4u);
+    size_t const path[5] = {0, 0, 1, 2, 3};
+    lca.build(path, 5);
+    BOOST_CHECK_EQUAL(lca(4, 1), 1u);
+    BOOST_CHECK_EQUAL(lca(3, 4), 3u);
+    BOOST_CHECK_EQUAL(lca(0, 4), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(query_cache_agrees)
+{
+    typedef lowest_common_ancestor<boost::adjacency_list<>> LCA;
+    LCA lca(g);
+    LCA::query_cache cache(64);
+    auto const n = num_vertices(g);
+    // Twice over all pairs: cold misses, then hits and evictions.
+    for (int round = 0; round != 2; round++)
+        for (size_t u = 0; u != n; u++)
+            for (size_t v = 0; v != n; v++)
+                BOOST_CHECK_EQUAL(lca(u, v, cache), lca(u, v));
+    // Growth never changes existing answers, so the cache stays valid.
+    lca.add_leaf(19, 20);
+    BOOST_CHECK_EQUAL(lca(20, 17, cache), 4u);
+    BOOST_CHECK_EQUAL(lca(20, 17, cache), lca(20, 17));
+}
+
+BOOST_AUTO_TEST_CASE(builder_pipelined_agrees)
+{
+    // Big enough that the table stage genuinely trails the tour.
+    size_t const n = 50000;
+    boost::adjacency_list<> tree;
+    std::mt19937 engine(5);
+    for (size_t v = 1; v != n; v++)
+    {
+        std::uniform_int_distribution<size_t> parent(v < 32 ? 0 : v - 32, v - 1);
+        add_edge(parent(engine), v, tree);
+    }
+    LCA_builder<boost::adjacency_list<>> sequential, pipelined;
+    auto const a = sequential.build(tree);
+    auto const b = pipelined.build_pipelined(tree);
+    std::uniform_int_distribution<size_t> vertex(0, n - 1);
+    for (int k = 0; k != 20000; k++)
+    {
+        size_t const u = vertex(engine), v = vertex(engine);
+        BOOST_CHECK_EQUAL(b(u, v), a(u, v));
+    }
+    // Degenerate sizes take the sequential path.
+    boost::adjacency_list<> single;
+    add_vertex(single);
+    BOOST_CHECK_EQUAL(pipelined.build_pipelined(single)(0, 0), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(narrow_index_query)
+{
+    typedef lowest_common_ancestor<boost::adjacency_list<>> wide_LCA;
+    typedef lowest_common_ancestor<boost::adjacency_list<>, uint16_t, uint32_t> narrow_LCA;
+    wide_LCA const wide(g);
+    narrow_LCA const narrow(g), narrow_pm1(g, narrow_LCA::engine::pm1);
+    for (size_t u = 0; u != num_vertices(g); u++)
+        for (size_t v = u; v != num_vertices(g); v++)
+        {
+            BOOST_CHECK_EQUAL(wide(u, v), narrow(u, v));
+            BOOST_CHECK_EQUAL(wide(u, v), narrow_pm1(u, v));
+        }
+}
+
+BOOST_AUTO_TEST_CASE(narrow_index_add_leaf)
+{
+    typedef lowest_common_ancestor<boost::adjacency_list<>, uint16_t, uint32_t> LCA;
+    LCA lca(g);
+    lca.add_leaf(9, 20);
+    lca.add_leaf(20, 21);
+    BOOST_CHECK_EQUAL(lca(21, 18), 4u);
+    lca.compact();
+    BOOST_CHECK_EQUAL(lca(20, 21), 20u);
+    BOOST_CHECK_EQUAL(lca(21, 18), 4u);
+    BOOST_CHECK_EQUAL(lca(14, 16), 7u);
+}
+
+BOOST_AUTO_TEST_CASE(batch_query_matches_scalar)
+{
+    typedef lowest_common_ancestor<boost::adjacency_list<>> LCA;
+    LCA const sparse(g), pm1(g, LCA::engine::pm1);
+    vector<pair<size_t, size_t>> pairs;
+    vector<size_t> expected;
+    for (size_t u = 0; u != num_vertices(g); u++)
+        for (size_t v = 0; v != num_vertices(g); v++)
+        {
+            pairs.push_back(make_pair(u, v));
+            expected.push_back(sparse(u, v));
+        }
+    vector<size_t> batched(pairs.size());
+    sparse.query_batch(pairs.begin(), pairs.end(), batched.begin());
+    BOOST_CHECK_EQUAL_COLLECTIONS(batched.begin(), batched.end(),
+                                  expected.begin(), expected.end());
+    pm1.query_batch(pairs.begin(), pairs.end(), batched.begin());
+    BOOST_CHECK_EQUAL_COLLECTIONS(batched.begin(), batched.end(),
+                                  expected.begin(), expected.end());
+}
+
+BOOST_AUTO_TEST_CASE(engines_agree)
+{
+    typedef lowest_common_ancestor<boost::adjacency_list<>> LCA;
+    LCA const a(g), b(g, LCA::engine::pm1);
+    for (size_t u = 0; u != num_vertices(g); u++)
+        for (size_t v = u; v != num_vertices(g); v++)
+            BOOST_CHECK_EQUAL(a(u, v), b(u, v));
+}
+
+BOOST_AUTO_TEST_CASE(add_leaf_incremental)
+{
+    typedef lowest_common_ancestor<boost::adjacency_list<>> LCA;
+    LCA lca(g);
+    lca.add_leaf(9, 20);   // under 9, itself under 4
+    lca.add_leaf(20, 21);
+    lca.add_leaf(21, 22);
+    BOOST_CHECK_EQUAL(lca(20, 21), 20u);
+    BOOST_CHECK_EQUAL(lca(22, 20), 20u);
+    BOOST_CHECK_EQUAL(lca(21, 18), 4u);
+    BOOST_CHECK_EQUAL(lca(20, 12), 1u);
+    BOOST_CHECK_EQUAL(lca(22, 22), 22u);
+    BOOST_CHECK_EQUAL(lca(11, 12), 1u);
+    lca.add_leaf(2, 23);
+    lca.add_leaf(23, 24);  // five pending: triggers compaction
+    BOOST_CHECK(lca.representative().size() == 25u);
+    BOOST_CHECK_EQUAL(lca(20, 21), 20u);
+    BOOST_CHECK_EQUAL(lca(21, 18), 4u);
+    BOOST_CHECK_EQUAL(lca(24, 13), 2u);
+    BOOST_CHECK_EQUAL(lca(24, 22), 0u);
+    BOOST_CHECK_EQUAL(lca(17, 19), 4u);
+}
+
+BOOST_AUTO_TEST_CASE(add_leaf_pm1_engine)
+{
+    typedef lowest_common_ancestor<boost::adjacency_list<>> LCA;
+    LCA lca(g, LCA::engine::pm1);
+    lca.add_leaf(9, 20);
+    lca.add_leaf(20, 21);
+    BOOST_CHECK_EQUAL(lca(21, 18), 4u);
+    lca.compact();
+    BOOST_CHECK_EQUAL(lca(21, 18), 4u);
+    BOOST_CHECK_EQUAL(lca(20, 21), 20u);
+    BOOST_CHECK_EQUAL(lca(14, 16), 7u);
+}
+
+BOOST_AUTO_TEST_CASE(frozen_view_concurrent_query)
+{
+    typedef lowest_common_ancestor<boost::adjacency_list<>> LCA;
+    LCA const lca(g);
+    LCA::frozen_view const view = lca.freeze();
+    static_assert(std::is_trivially_copyable<LCA::frozen_view>::value,
+                  "frozen views must be cheap to hand to each thread");
+    for (size_t u = 0; u != num_vertices(g); u++)
+        for (size_t v = u; v != num_vertices(g); v++)
+            BOOST_CHECK_EQUAL(view(u, v), lca(u, v));
+
+    vector<thread> pool;
+    vector<size_t> failures(4, 0);
+    for (size_t t = 0; t != failures.size(); t++)
+        pool.emplace_back([&, t, view]  // each thread its own copy
+        {
+            for (size_t u = 0; u != num_vertices(g); u++)
+                for (size_t v = 0; v != num_vertices(g); v++)
+                    failures[t] += view(u, v) != lca(u, v);
+        });
+    for (thread &worker : pool)
+        worker.join();
+    BOOST_CHECK_EQUAL(accumulate(failures.begin(), failures.end(), 0u), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(snapshot_round_trip)
+{
+    typedef lowest_common_ancestor<boost::adjacency_list<>> LCA;
+    string const path = "Bender_2005_2.lca";
+    LCA const original(g);
+    original.save(path);
+    LCA const loaded(path);
+    for (size_t u = 0; u != num_vertices(g); u++)
+        for (size_t v = u; v != num_vertices(g); v++)
+            BOOST_CHECK_EQUAL(original(u, v), loaded(u, v));
+
+    vector<pair<size_t, size_t>> const pairs = {{11, 12}, {17, 19}, {14, 16}};
+    vector<size_t> batched(pairs.size());
+    loaded.query_batch(pairs.begin(), pairs.end(), batched.begin());
+    BOOST_CHECK_EQUAL(batched[0], 1u);
+    BOOST_CHECK_EQUAL(batched[1], 4u);
+    BOOST_CHECK_EQUAL(batched[2], 7u);
+    remove(path.c_str());
+
+    BOOST_CHECK_THROW(LCA missing("no_such_snapshot.lca"), std::runtime_error);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
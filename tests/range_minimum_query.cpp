@@ -2,6 +2,7 @@
 #define BOOST_TEST_MAIN
 #include <boost/test/unit_test.hpp>
 
+#include <numa_replication.hpp>
 #include <range_minimum_query.hpp>
 
 #include <boost/mpl/vector.hpp>
@@ -17,6 +18,8 @@
 #include <iterator>
 #include <locale>
 #include <iostream>
+#include <random>
+#include <vector>
 
 using namespace boost;
 using namespace general;
@@ -28,6 +31,104 @@ struct enable_locale
 
 BOOST_GLOBAL_FIXTURE(enable_locale);
 
+BOOST_AUTO_TEST_CASE(frozen_view_agrees)
+{
+    boost::container::vector<unsigned> a;
+    std::mt19937 engine(7);
+    std::uniform_int_distribution<unsigned> d(0, 100);
+    for (int k = 0; k != 100; k++)
+        a.push_back(d(engine));
+    range_minimum_query<boost::container::vector<unsigned>> const q(a);
+    auto const view = q.freeze();
+    for (std::size_t i = 0; i != a.size(); i++)
+        for (std::size_t j = i; j != a.size(); j++)
+            BOOST_CHECK_EQUAL(view(i, j), q(i, j));
+}
+
+BOOST_AUTO_TEST_CASE(tiled_layout_agrees)
+{
+    // Enough elements for several tiles.
+    boost::container::vector<unsigned> a(3000);
+    std::mt19937 engine(11);
+    std::uniform_int_distribution<unsigned> d(0, 100000);
+    for (auto &x : a)
+        x = d(engine);
+    typedef range_minimum_query<boost::container::vector<unsigned>> query_type;
+    query_type const row_major(a), tiled(a, 1, query_type::layout::tiled);
+    std::uniform_int_distribution<std::size_t> index(0, a.size() - 1);
+    for (int k = 0; k != 2000; k++)
+    {
+        std::size_t i = index(engine), j = index(engine);
+        if (j < i)
+            std::swap(i, j);
+        BOOST_CHECK_EQUAL(tiled(i, j), row_major(i, j));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(numa_replicated_agrees)
+{
+    boost::container::vector<unsigned> a(500);
+    std::mt19937 engine(17);
+    std::uniform_int_distribution<unsigned> d(0, 1000);
+    for (auto &x : a)
+        x = d(engine);
+    typedef range_minimum_query<boost::container::vector<unsigned>> query_type;
+    query_type const direct(a);
+    general::numa_replicated<query_type> const replicas([&]{ return query_type(a); });
+    BOOST_REQUIRE(replicas.replicas() >= 1);
+    std::uniform_int_distribution<std::size_t> index(0, a.size() - 1);
+    for (int k = 0; k != 500; k++)
+    {
+        std::size_t i = index(engine), j = index(engine);
+        if (j < i)
+            std::swap(i, j);
+        for (std::size_t node = 0; node != replicas.replicas(); node++)
+            BOOST_CHECK_EQUAL(replicas.replica(node)(i, j), direct(i, j));
+    }
+    BOOST_CHECK_EQUAL(replicas.local()(0, a.size() - 1), direct(0, a.size() - 1));
+}
+
+BOOST_AUTO_TEST_CASE(static_extent_agrees)
+{
+    std::size_t const n = 256;
+    boost::container::vector<unsigned> a(n);
+    std::mt19937 engine(13);
+    std::uniform_int_distribution<unsigned> d(0, 50);
+    for (auto &x : a)
+        x = d(engine);
+    static_range_minimum_query<unsigned, n> const fixed(a);
+    range_minimum_query<boost::container::vector<unsigned>> const dynamic(a);
+    BOOST_CHECK_EQUAL(sizeof(fixed.operator()(0, 0)), 1u); // index_t is a byte
+    for (std::size_t i = 0; i != n; i++)
+        for (std::size_t j = i; j != n; j++)
+            BOOST_CHECK_EQUAL(std::size_t(fixed(i, j)), std::size_t(dynamic(i, j)));
+    // Degenerate extents exercise the branch-only query paths.
+    unsigned const pair[2] = {4, 3};
+    static_range_minimum_query<unsigned, 2> const two(pair);
+    BOOST_CHECK_EQUAL(two(0, 1), 1u);
+    unsigned const lone[1] = {9};
+    static_range_minimum_query<unsigned, 1> const one(lone);
+    BOOST_CHECK_EQUAL(one(0, 0), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(contiguous_kernel_agrees)
+{
+    // int32 values with 32-bit index rows select the branch-free/SIMD
+    // construction kernels; check them against the generic path.
+    std::mt19937 engine(1729);
+    std::uniform_int_distribution<std::int32_t> d(-1000, 1000);
+    std::vector<std::int32_t> a(517);
+    for (auto &x : a)
+        x = d(engine);
+    flat_table<std::uint32_t> narrow(sparse_table_rows(a.size()), a.size());
+    flat_table<std::ptrdiff_t> wide(sparse_table_rows(a.size()), a.size());
+    RMQ_sparse_table(a.data(), std::ptrdiff_t(a.size()), narrow);
+    RMQ_sparse_table(a, wide);
+    for (std::size_t k = 0; k != narrow.rows(); k++)
+        for (std::size_t i = 0; i != narrow.columns(); i++)
+            BOOST_CHECK_EQUAL(narrow[k][i], wide[k][i]);
+}
+
 // Simple function to calculate RMQ in linear time.
 template <typename C, typename N>
 N RMQ_linear(N i, N j, C const &A)
@@ -167,52 +268,126 @@ BOOST_FIXTURE_TEST_CASE(test_query16, index_16)
         }
 }
 
+BOOST_AUTO_TEST_CASE(parallel_construction_agrees)
+{
+    std::mt19937 engine;
+    std::uniform_int_distribution<unsigned> d;
+    boost::container::vector<unsigned> A(1u << 16);
+    std::generate(A.begin(), A.end(), [&]{ return d(engine); });
+
+    range_minimum_query< boost::container::vector<unsigned> > sequential(A), parallel(A, 4);
+    std::uniform_int_distribution<std::size_t> index(0, A.size() - 1);
+    for (int k = 0; k != 1000; k++)
+    {
+        std::size_t i = index(engine), j = index(engine);
+        if (j < i)
+            std::swap(i, j);
+        BOOST_CHECK_EQUAL(sequential(i, j), parallel(i, j));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 
-#ifdef NDEBUG
+// A ±1 sequence in the style of an Euler-tour level sequence.
+struct pm1_walk
+{
+    boost::container::vector<unsigned> A;
 
-#include "measurement.hpp"
+    pm1_walk()
+    {
+        std::mt19937 engine;
+        std::bernoulli_distribution step;
+        A.push_back(100);
+        for (int i = 0; i != 200; i++)
+            A.push_back(step(engine) ? A.back() + 1 : A.back() - 1);
+    }
+};
 
-#include <algorithm>
-#include <random>
+BOOST_AUTO_TEST_SUITE(pm1_RMQ_index)
 
-struct random_RMQ
+BOOST_AUTO_TEST_CASE(pm1_trivial_1)
 {
-    mt19937 engine;
-    uniform_int_distribution<unsigned> d;
-    vector<unsigned> a;
-    typedef BOOST_DEDUCED_TYPENAME vector<unsigned>::const_iterator const_iterator;
-    
-    random_RMQ() : d(0, (1ul << 32) - 1)
+    boost::array<unsigned, 1> A = {3};
+    pm1_range_minimum_query< boost::array<unsigned, 1> > q(A);
+    BOOST_CHECK_EQUAL(0, q(0, 0));
+}
+
+BOOST_AUTO_TEST_CASE(pm1_trivial_2)
+{
+    boost::array<unsigned, 2> A = {3, 4};
+    pm1_range_minimum_query< boost::array<unsigned, 2> > q(A);
+    BOOST_CHECK_EQUAL(0, q(0, 1));
+
+    swap(A[0], A[1]);
+    q = make_pm1_range_minimum_query(A);
+    BOOST_CHECK_EQUAL(1, q(0, 1));
+}
+
+BOOST_FIXTURE_TEST_CASE(pm1_exhaustive_query, pm1_walk)
+{
+    pm1_range_minimum_query< boost::container::vector<unsigned> > foo(A);
+    for(unsigned i = 0; i < A.size(); i++)
+        for(unsigned j = i; j < A.size(); j++)
+        {
+            std::size_t minimum = foo(i, j);
+            BOOST_CHECK_EQUAL(minimum, RMQ_linear(i, j, A));
+        }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+struct chunked_walk
+{
+    boost::container::vector<std::int32_t> a;
+
+    chunked_walk()
+    {
+        std::mt19937 engine(42);
+        std::uniform_int_distribution<std::int32_t> d(-10000, 10000);
+        a.resize(1003);
+        for (auto &x : a)
+            x = d(engine);
+    }
+
+    void feed(chunked_range_minimum_query<std::int32_t> &q) const
     {
-        fill_n(back_inserter(a), 1ul << 22, d(engine));
+        // Stream in uneven stretches to exercise chunk boundaries.
+        std::size_t at = 0;
+        for (std::size_t stretch = 1; at != a.size(); stretch = stretch * 2 + 1)
+        {
+            std::size_t const length = std::min(stretch, a.size() - at);
+            q.append(std::vector<std::int32_t>(a.begin() + at, a.begin() + at + length));
+            at += length;
+        }
+        q.finish();
     }
 };
 
-BOOST_FIXTURE_TEST_SUITE(measure_RMQ, random_RMQ)
+BOOST_FIXTURE_TEST_SUITE(chunked_RMQ_index, chunked_walk)
 
-BOOST_AUTO_TEST_CASE(measure_RMQ_preprocess)
+BOOST_AUTO_TEST_CASE(chunked_exhaustive_query)
 {
-    typedef boost::multi_array_types::extent_range range;
-    boost::multi_array<std::size_t, 2> M((boost::extents[range(1, 23)][1 << 22ul]));
-    auto const f = [&]()
-    {
-        RMQ_preprocess(a, M);
-    };
-    measure(a.size(), 1u << 4, f);
+    chunked_range_minimum_query<std::int32_t> q(32);
+    feed(q);
+    BOOST_REQUIRE_EQUAL(q.size(), a.size());
+    for (std::size_t i = 0; i < a.size(); i += 7)
+        for (std::size_t j = i; j < a.size(); j += 11)
+            BOOST_CHECK_EQUAL(q(i, j), RMQ_linear(i, j, a));
 }
 
-
-BOOST_AUTO_TEST_CASE(measure_RMQ_query)
+BOOST_AUTO_TEST_CASE(chunked_spilled_query)
 {
-    typedef boost::multi_array_types::extent_range range;
-    boost::multi_array<std::size_t, 2> M((boost::extents[range(1, 23)][1 << 22ul]));
-    RMQ_preprocess(a, M);
-    auto const f = bind(RMQ<std::size_t, decltype(a), decltype(M)>, 0, a.size() - 1, a, M);
-    measure(1, 1ul << 29, f, "query");
+    std::string const path = "chunked_rmq.spill";
+    chunked_range_minimum_query<std::int32_t> q(32, path);
+    feed(q);
+    for (std::size_t i = 0; i < a.size(); i += 13)
+        for (std::size_t j = i; j < a.size(); j += 17)
+            BOOST_CHECK_EQUAL(q(i, j), RMQ_linear(i, j, a));
+    std::remove(path.c_str());
 }
 
 BOOST_AUTO_TEST_SUITE_END()
 
-#endif
+// Performance is tracked by the Google Benchmark suite in benchmarks/,
+// which replaced the measure() regression checks that used to live here.
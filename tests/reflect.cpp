@@ -30,6 +30,7 @@
 #include <boost/graph/adjacency_list.hpp>
 #include <boost/graph/adjacency_list_io.hpp>
 #include <boost/graph/adjacency_matrix.hpp>
+#include <boost/graph/compressed_sparse_row_graph.hpp>
 #include <boost/graph/copy.hpp>
 #include <boost/graph/isomorphism.hpp>
 #include <boost/graph/transitive_closure.hpp>
@@ -102,4 +103,85 @@ BOOST_AUTO_TEST_CASE(test_reflect_through_sources_2)
     BOOST_REQUIRE(boost::isomorphism(h, F));
 }
 
+
+BOOST_AUTO_TEST_CASE(test_reflect_through_sources_workspace)
+{
+    reflection_workspace<DefaultAdjacencyList> workspace;
+    DefaultAdjacencyList expected;
+    add_Bender_2005_4_F(expected);
+    // Reuse the one workspace across several reflections.
+    for (int round = 0; round != 3; round++)
+    {
+        DefaultAdjacencyList G;
+        add_Bender_2005_4(G);
+        DefaultAdjacencyList F;
+        reflect_through_sources(G, F, workspace);
+        BOOST_CHECK_EQUAL(num_vertices(F), num_vertices(expected));
+        BOOST_REQUIRE_EQUAL(num_edges(F), num_edges(expected));
+        BOOST_REQUIRE(boost::isomorphism(F, expected));
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE(test_reflect_through_sources_csr)
+{
+    boost::compressed_sparse_row_graph<boost::directedS> F;
+    auto const offset = reflect_through_sources(g, F);
+    BOOST_CHECK_EQUAL(offset, 6u);
+    DefaultAdjacencyList h;
+    add_Bender_2005_4_F(h);
+    BOOST_CHECK_EQUAL(num_vertices(F), num_vertices(h));
+    BOOST_REQUIRE_EQUAL(num_edges(F), num_edges(h));
+    // The CSR path reproduces the exact vertex numbering, not merely an
+    // isomorphic graph.
+    auto const E = edges(F);
+    std::for_each(E.first, E.second, [&](boost::graph_traits<decltype(F)>::edge_descriptor e)
+    {
+        BOOST_CHECK(edge(source(e, F), target(e, F), h).second);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_reflect_through_explicit_sources)
+{
+    typedef boost::compressed_sparse_row_graph<boost::directedS> CSR;
+    // With the sources listed in numbering order, the remap reduces to the
+    // uniform offset of the implicit overload.
+    CSR implicit_F, explicit_F;
+    auto const offset = reflect_through_sources(g, implicit_F);
+    std::vector<std::size_t> const sources = {0, 1, 2, 3, 4};
+    std::vector<std::size_t> reflected;
+    reflect_through_sources(g, sources.begin(), sources.end(), explicit_F, reflected);
+    for (std::size_t v = 0; v != num_vertices(g); v++)
+        BOOST_CHECK_EQUAL(reflected[v], v < sources.size() ? v : v + offset);
+    BOOST_CHECK_EQUAL(num_vertices(explicit_F), num_vertices(implicit_F));
+    BOOST_REQUIRE_EQUAL(num_edges(explicit_F), num_edges(implicit_F));
+
+    // An arbitrary renumbering no longer needs fixing up first.
+    std::vector<std::size_t> const to_new = {7, 2, 10, 0, 5, 1, 3, 8, 4, 6, 9};
+    DefaultAdjacencyList permuted(num_vertices(g));
+    auto const E = edges(g);
+    std::for_each(E.first, E.second, [&](boost::graph_traits<decltype(g)>::edge_descriptor e)
+    {
+        add_edge(to_new[source(e, g)], to_new[target(e, g)], permuted);
+    });
+    std::vector<std::size_t> permuted_sources;
+    for (std::size_t v = 0; v != to_new.size(); v++)
+        if (std::find(to_new.begin(), to_new.begin() + 5, v) != to_new.begin() + 5)
+            permuted_sources.push_back(v);
+    CSR F;
+    reflect_through_sources(permuted, permuted_sources.begin(), permuted_sources.end(),
+                            F, reflected);
+    DefaultAdjacencyList as_list(num_vertices(F));
+    auto const R = edges(F);
+    std::for_each(R.first, R.second, [&](boost::graph_traits<CSR>::edge_descriptor e)
+    {
+        add_edge(source(e, F), target(e, F), as_list);
+    });
+    DefaultAdjacencyList expected;
+    add_Bender_2005_4_F(expected);
+    BOOST_CHECK_EQUAL(num_vertices(as_list), num_vertices(expected));
+    BOOST_REQUIRE_EQUAL(num_edges(as_list), num_edges(expected));
+    BOOST_REQUIRE(boost::isomorphism(as_list, expected));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -43,6 +43,28 @@ BOOST_AUTO_TEST_CASE(test_lower_log2)
 }
 
 
+BOOST_AUTO_TEST_CASE(test_lower_log2_agrees_with_shift_loop)
+{
+    auto const reference = [](unsigned long long n)
+    {
+        char result = 0;
+        while (n >>= 1u)
+            result++;
+        return result;
+    };
+    for (unsigned long long n = 1; n != 1u << 17; n++)
+        BOOST_CHECK_EQUAL(lower_log2(n), reference(n));
+    // Every bit position, and the values either side of it.
+    for (int b = 1; b != 64; b++)
+    {
+        unsigned long long const p = 1ull << b;
+        BOOST_CHECK_EQUAL(lower_log2(p - 1), reference(p - 1));
+        BOOST_CHECK_EQUAL(lower_log2(p), reference(p));
+        BOOST_CHECK_EQUAL(lower_log2(p + 1), reference(p + 1));
+    }
+}
+
+
 BOOST_AUTO_TEST_CASE(test_upper_log2)
 {
     std::vector<int> const q = {1, 2, 3, 4, 5, 7, 8};
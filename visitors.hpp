@@ -31,6 +31,7 @@
  * finish_vertex with checks for duplicate vertices.
  */
 
+#include "visitors/euler_tour.hpp"
 #include "visitors/eulerian_path.hpp"
 #include "visitors/vertex_depth.hpp"
 
@@ -56,6 +57,9 @@ bool prop_relation_wrapper(Vertex u, Graph const &, KeyValueMap m, Value x, Rela
 }
 
 
+// NOTE: find_common_ancestor_impl no longer terminates through this visitor;
+// it exits its search loop by normal return.  Kept for external callers, but
+// bear in mind that the throw costs far more than a short search does.
 template <typename BinaryPredicate, typename Tag>
 class stop_on_vertex : public boost::base_visitor<stop_on_vertex<BinaryPredicate, Tag>>
 {
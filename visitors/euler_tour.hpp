@@ -0,0 +1,93 @@
+/*
+ *    Copyright (C) 2017  Jeremy W. Murphy <jeremy.william.murphy@gmail.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EULER_TOUR
+#define EULER_TOUR
+
+#include <boost/graph/depth_first_search.hpp>
+
+#include <cstddef>
+
+namespace graph_algorithms
+{
+
+/** @brief DFS visitor that emits tour, level and representative together.
+ *
+ *  Fuses eulerian_path and vertex_depth into one traversal and also records
+ *  each vertex's representative (an occurrence of it in the tour), so LCA
+ *  preprocessing walks the tree once instead of twice.  Output is written
+ *  by index into preallocated random-access sequences of length 2n - 1.
+ */
+template <typename Vertex, typename VertexIterator, typename LevelIterator,
+          typename IndexIterator>
+struct euler_tour : public boost::default_dfs_visitor
+{
+    VertexIterator tour_index;
+    LevelIterator tour_level;
+    IndexIterator representative;
+    std::size_t position;
+    std::size_t depth;
+    Vertex previous;
+    bool start;
+
+    euler_tour(VertexIterator tour_index, LevelIterator tour_level,
+               IndexIterator representative)
+    : tour_index(tour_index), tour_level(tour_level),
+      representative(representative), position(0), depth(0), previous(),
+      start(true) {}
+
+    void emit(Vertex v)
+    {
+        tour_index[position] = v;
+        tour_level[position] = depth;
+        representative[v] = position++;
+    }
+
+    // See the comment in visitors.hpp for the reason why this is complicated.
+    template <typename Edge, typename Graph>
+    void tree_edge(Edge const &e, Graph const &g)
+    {
+        if(start || source(e, g) != previous)
+            emit(source(e, g));
+        start = false;
+        ++depth;
+        emit(previous = target(e, g));
+    }
+
+    template <typename Graph>
+    void finish_vertex(Vertex const &v, Graph const &)
+    {
+        if(start || v != previous)
+            emit(v);
+        start = false;
+        --depth;
+    }
+};
+
+
+template <typename Vertex, typename VertexIterator, typename LevelIterator,
+          typename IndexIterator>
+euler_tour<Vertex, VertexIterator, LevelIterator, IndexIterator>
+make_euler_tour(VertexIterator tour_index, LevelIterator tour_level,
+                IndexIterator representative)
+{
+    return euler_tour<Vertex, VertexIterator, LevelIterator, IndexIterator>(tour_index, tour_level, representative);
+}
+
+} // graph_ancestry
+
+#endif